@@ -16,6 +16,8 @@ BuildRequires: pkgconfig(dbus-1)
 BuildRequires: pkgconfig(dbus-glib-1)
 BuildRequires: pkgconfig(libsystemd-journal)
 BuildRequires: pkgconfig(sqlite3)
+BuildRequires: pkgconfig(openssl)
+BuildRequires: pkgconfig(libcurl)
 
 
 %description
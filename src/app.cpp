@@ -29,6 +29,12 @@
 
 namespace CCHECKER {
 
+signature_file_t::signature_file_t(void):
+        inode(0),
+        size(0),
+        mtime(0)
+{}
+
 app_t::app_t(void):
         check_id(-1),   // -1 as invalid check_id - assume that in database
                         // all check_ids will be positive
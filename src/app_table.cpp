@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        app_table.cpp
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Compact, column-wise table of apps waiting for check
+ */
+#include <limits>
+#include <utility>
+
+#include <log.h>
+#include <app_table.h>
+
+namespace {
+
+// Removed rows which trigger compaction, if there are more than left ones
+const size_t MIN_COMPACT_ROWS = 64;
+
+// Heap used by node of unordered_map - next pointer and cached hash
+const size_t MAP_NODE_OVERHEAD = 2 * sizeof(void *);
+
+template <typename T>
+size_t capacity_bytes(const std::vector<T> &vector)
+{
+    return vector.capacity() * sizeof(T);
+}
+
+template <typename Map>
+size_t map_bytes(const Map &map)
+{
+    return map.bucket_count() * sizeof(void *) +
+           map.size() * (sizeof(typename Map::value_type) + MAP_NODE_OVERHEAD);
+}
+
+// Heap used by string itself, 0 if it fits into small string buffer
+size_t string_bytes(const std::string &value)
+{
+    return value.capacity() > sizeof(std::string) - 2 * sizeof(size_t) ?
+           value.capacity() + 1 : 0;
+}
+
+} //anonymus
+
+namespace CCHECKER {
+
+AppTable::AppTable(void) :
+    m_removed(0)
+{}
+
+void AppTable::add(const app_t &app)
+{
+    size_t count = app.certificates.size();
+    if (count > std::numeric_limits<uint16_t>::max()) {
+        LogError("Too many certificates of " << app.str() << ", extra ones are skipped");
+        count = std::numeric_limits<uint16_t>::max();
+    }
+
+    m_check_id.push_back(app.check_id);
+    m_pkg_id.push_back(intern_string(app.pkg_id));
+    m_app_id.push_back(intern_string(app.app_id));
+    m_uid.push_back(app.uid);
+    m_verified.push_back(static_cast<uint8_t>(app.verified));
+    m_certs_begin.push_back(static_cast<index_t>(m_cert_refs.size()));
+    m_certs_count.push_back(static_cast<uint16_t>(count));
+
+    for (size_t i = 0; i < count; ++i)
+        m_cert_refs.push_back(intern_cert(app.certificates[i]));
+}
+
+bool AppTable::remove(const app_t &app)
+{
+    for (size_t i = 0; i < m_check_id.size(); ++i) {
+        if (m_check_id[i] != app.check_id || m_uid[i] != app.uid ||
+            *m_strings[m_pkg_id[i]] != app.pkg_id ||
+            *m_strings[m_app_id[i]] != app.app_id)
+            continue;
+
+        erase_row(i);
+        if (++m_removed >= MIN_COMPACT_ROWS && m_removed > size())
+            compact();
+        return true;
+    }
+    return false;
+}
+
+void AppTable::select(app_t::verified_t verified, std::vector<app_t> &apps) const
+{
+    uint8_t status = static_cast<uint8_t>(verified);
+    for (size_t i = 0; i < m_verified.size(); ++i)
+        if (m_verified[i] == status) {
+            apps.emplace_back();
+            read_row(i, apps.back());
+        }
+}
+
+size_t AppTable::size(void) const
+{
+    return m_check_id.size();
+}
+
+AppTable::footprint_t AppTable::footprint(void) const
+{
+    footprint_t footprint;
+    footprint.apps = size();
+    footprint.strings = m_strings.size();
+    footprint.certificates = m_certs.size();
+    footprint.cert_bytes = 0;
+    footprint.bytes = capacity_bytes(m_check_id) + capacity_bytes(m_pkg_id) +
+                      capacity_bytes(m_app_id) + capacity_bytes(m_uid) +
+                      capacity_bytes(m_verified) + capacity_bytes(m_certs_begin) +
+                      capacity_bytes(m_certs_count) + capacity_bytes(m_cert_refs) +
+                      capacity_bytes(m_strings) + capacity_bytes(m_certs) +
+                      map_bytes(m_string_index) + map_bytes(m_cert_index);
+
+    for (const auto &value : m_string_index)
+        footprint.bytes += string_bytes(value.first);
+    for (const auto &cert : m_certs)
+        footprint.cert_bytes += cert->der.size();
+
+    return footprint;
+}
+
+AppTable::index_t AppTable::intern_string(const std::string &value)
+{
+    auto result = m_string_index.insert(
+            std::make_pair(value, static_cast<index_t>(m_strings.size())));
+    if (result.second)
+        m_strings.push_back(&result.first->first);
+    return result.first->second;
+}
+
+AppTable::index_t AppTable::intern_cert(const cert_ptr &cert)
+{
+    auto result = m_cert_index.insert(
+            std::make_pair(cert.get(), static_cast<index_t>(m_certs.size())));
+    if (result.second)
+        m_certs.push_back(cert);
+    return result.first->second;
+}
+
+void AppTable::read_row(size_t i, app_t &app) const
+{
+    app.check_id = m_check_id[i];
+    app.pkg_id = *m_strings[m_pkg_id[i]];
+    app.app_id = *m_strings[m_app_id[i]];
+    app.uid = m_uid[i];
+    app.verified = static_cast<app_t::verified_t>(m_verified[i]);
+
+    app.certificates.reserve(m_certs_count[i]);
+    for (index_t j = 0; j < m_certs_count[i]; ++j)
+        app.certificates.push_back(m_certs[m_cert_refs[m_certs_begin[i] + j]]);
+}
+
+// Last row takes place of the removed one, its certificates stay in place
+void AppTable::erase_row(size_t i)
+{
+    size_t last = m_check_id.size() - 1;
+    m_check_id[i] = m_check_id[last];
+    m_pkg_id[i] = m_pkg_id[last];
+    m_app_id[i] = m_app_id[last];
+    m_uid[i] = m_uid[last];
+    m_verified[i] = m_verified[last];
+    m_certs_begin[i] = m_certs_begin[last];
+    m_certs_count[i] = m_certs_count[last];
+
+    m_check_id.pop_back();
+    m_pkg_id.pop_back();
+    m_app_id.pop_back();
+    m_uid.pop_back();
+    m_verified.pop_back();
+    m_certs_begin.pop_back();
+    m_certs_count.pop_back();
+}
+
+// Drops certificate references, strings and certificates of removed apps
+void AppTable::compact(void)
+{
+    AppTable table;
+    app_t app;
+    for (size_t i = 0; i < size(); ++i) {
+        app.certificates.clear();
+        read_row(i, app);
+        table.add(app);
+    }
+    swap(table);
+}
+
+void AppTable::swap(AppTable &other)
+{
+    m_check_id.swap(other.m_check_id);
+    m_pkg_id.swap(other.m_pkg_id);
+    m_app_id.swap(other.m_app_id);
+    m_uid.swap(other.m_uid);
+    m_verified.swap(other.m_verified);
+    m_certs_begin.swap(other.m_certs_begin);
+    m_certs_count.swap(other.m_certs_count);
+    m_cert_refs.swap(other.m_cert_refs);
+    std::swap(m_removed, other.m_removed);
+    // Nodes are moved along with the maps, m_strings stays valid
+    m_string_index.swap(other.m_string_index);
+    m_strings.swap(other.m_strings);
+    m_cert_index.swap(other.m_cert_index);
+    m_certs.swap(other.m_certs);
+}
+
+} // CCHECKER
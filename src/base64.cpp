@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        base64.cpp
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Base64 decoder
+ */
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CCHECKER_BASE64_X86
+#include <immintrin.h>
+#endif
+
+#include <base64.h>
+
+namespace {
+
+const uint8_t INVALID = 0xff;
+const uint8_t SKIP    = 0xfe; // whitespace
+const uint8_t PAD     = 0xfd;
+
+// Vector decoders may write this many bytes past the decoded data
+const size_t OUTPUT_SLACK = 8;
+
+struct decode_table_t {
+    uint8_t values[256];
+
+    decode_table_t(void)
+    {
+        for (int i = 0; i < 256; ++i)
+            values[i] = INVALID;
+
+        const char *alphabet =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (uint8_t i = 0; i < 64; ++i)
+            values[static_cast<uint8_t>(alphabet[i])] = i;
+
+        values[static_cast<uint8_t>(' ')] = SKIP;
+        values[static_cast<uint8_t>('\t')] = SKIP;
+        values[static_cast<uint8_t>('\r')] = SKIP;
+        values[static_cast<uint8_t>('\n')] = SKIP;
+        values[static_cast<uint8_t>('=')] = PAD;
+    }
+};
+
+const decode_table_t DECODE_TABLE;
+
+/*
+ * Decodes whole blocks of alphabet characters from the beginning of in,
+ * writes 3 bytes per 4 characters to out. Stops at the first block with
+ * any other character (whitespace, padding, error), which is left for
+ * the scalar loop. Returns number of characters decoded.
+ */
+typedef size_t (*decode_blocks_t)(const char *in, size_t size, char *out);
+
+#ifdef CCHECKER_BASE64_X86
+
+/*
+ * 16 characters to 12 bytes, as described in "Faster Base64 Encoding and
+ * Decoding Using AVX2 Instructions" by W. Mula and D. Lemire. Nibbles of
+ * each character select bit masks which have a common bit only for
+ * characters outside of the alphabet.
+ *
+ * Always inlined, so that in AVX2 code it's VEX encoded as well - mixing
+ * it with legacy SSE encoding costs more than the whole decoding.
+ */
+__attribute__((target("sse4.1"), always_inline))
+inline size_t decode_blocks_128(const char *in, size_t size, char *out)
+{
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                         0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                         0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                           0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                       -1, -1, -1, -1);
+
+    size_t done = 0;
+    for (; size - done >= 16; done += 16, out += 12) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + done));
+
+        __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), mask_2f);
+        __m128i lo_nibbles = _mm_and_si128(chars, mask_2f);
+        __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        if (!_mm_testz_si128(lo, hi))
+            break;
+
+        // '/' is the only character which needs other offset than the
+        // rest of its high nibble group
+        __m128i eq_2f = _mm_cmpeq_epi8(chars, mask_2f);
+        __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+        __m128i values = _mm_add_epi8(chars, roll);
+
+        // 4 sextets -> 24 bits in each 32-bit lane, then bytes in order
+        __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        merged = _mm_shuffle_epi8(merged, pack);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), merged);
+    }
+    return done;
+}
+
+__attribute__((target("sse4.1")))
+size_t decode_blocks_sse41(const char *in, size_t size, char *out)
+{
+    return decode_blocks_128(in, size, out);
+}
+
+// As above, 32 characters to 24 bytes
+__attribute__((target("avx2")))
+size_t decode_blocks_avx2(const char *in, size_t size, char *out)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i lut_hi = _mm256_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    const __m256i pack = _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    size_t done = 0;
+    for (; size - done >= 32; done += 32, out += 24) {
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + done));
+
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(chars, 4), mask_2f);
+        __m256i lo_nibbles = _mm256_and_si256(chars, mask_2f);
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        if (!_mm256_testz_si256(lo, hi))
+            break;
+
+        __m256i eq_2f = _mm256_cmpeq_epi8(chars, mask_2f);
+        __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+        __m256i values = _mm256_add_epi8(chars, roll);
+
+        __m256i merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        merged = _mm256_shuffle_epi8(merged, pack);
+        // 12 bytes of each 128-bit lane next to each other
+        merged = _mm256_permutevar8x32_epi32(merged, lanes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), merged);
+    }
+
+    // Block with a line break may still have a whole 16 characters before it
+    return done + decode_blocks_128(in + done, size - done, out);
+}
+
+#endif // CCHECKER_BASE64_X86
+
+decode_blocks_t select_decoder(void)
+{
+#ifdef CCHECKER_BASE64_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return decode_blocks_avx2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return decode_blocks_sse41;
+#endif
+    return NULL;
+}
+
+// NULL if CPU has no supported vector extension
+const decode_blocks_t DECODE_BLOCKS = select_decoder();
+
+} //anonymus
+
+namespace CCHECKER {
+
+bool base64_decode(const char *data, size_t size, std::string &out)
+{
+    size_t first = out.size();
+    out.resize(first + size / 4 * 3 + 3 + OUTPUT_SLACK);
+    char *begin = &out[first];
+    char *dest = begin;
+
+    uint32_t quantum = 0;
+    size_t count = 0; // sextets in quantum
+    size_t i = 0;
+    bool ok = true;
+    for (; i < size; ++i) {
+        // Lines of XML signatures are whole quanta, vectors may pick up
+        // at the beginning of every line
+        if (DECODE_BLOCKS && count == 0 && size - i >= 16) {
+            size_t done = DECODE_BLOCKS(data + i, size - i, dest);
+            dest += done / 4 * 3;
+            i += done;
+            if (i == size)
+                break;
+        }
+
+        uint8_t value = DECODE_TABLE.values[static_cast<uint8_t>(data[i])];
+        if (value < 64) {
+            quantum = (quantum << 6) | value;
+            if (++count == 4) {
+                *dest++ = static_cast<char>(quantum >> 16);
+                *dest++ = static_cast<char>(quantum >> 8);
+                *dest++ = static_cast<char>(quantum);
+                quantum = 0;
+                count = 0;
+            }
+        } else if (value == PAD) {
+            break;
+        } else if (value != SKIP) {
+            ok = false;
+            break;
+        }
+    }
+
+    // Only padding and whitespace may follow the padding
+    for (; ok && i < size; ++i) {
+        uint8_t value = DECODE_TABLE.values[static_cast<uint8_t>(data[i])];
+        if (value != PAD && value != SKIP)
+            ok = false;
+    }
+
+    if (ok) {
+        switch (count) {
+        case 0:
+            break;
+        case 2:
+            *dest++ = static_cast<char>(quantum >> 4);
+            break;
+        case 3:
+            *dest++ = static_cast<char>(quantum >> 10);
+            *dest++ = static_cast<char>(quantum >> 2);
+            break;
+        default:
+            ok = false; // single sextet doesn't make a byte
+            break;
+        }
+    }
+
+    out.resize(first + (dest - begin));
+    return ok;
+}
+
+} // CCHECKER
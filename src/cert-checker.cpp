@@ -33,7 +33,7 @@ int main(void)
 
     GMainLoop *main_loop = g_main_loop_new(NULL, FALSE);
 
-    Logic logic;
+    Logic logic(OCSP_WORKERS, OCSP_CACHE_SIZE);
     if (logic.setup() != NO_ERROR) {
         LogError("Cannot setup logic. Exit cert-checker!");
         return -1;
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        cert_cache.cpp
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Cache of parsed certificates with data needed by OCSP
+ */
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/x509v3.h>
+
+#include <log.h>
+#include <cert_cache.h>
+
+namespace {
+
+std::string name_oneline(X509_NAME *x509_name)
+{
+    char *name = X509_NAME_oneline(x509_name, NULL, 0);
+    if (!name)
+        return std::string();
+
+    std::string ret(name);
+    OPENSSL_free(name);
+    return ret;
+}
+
+} //anonymus
+
+namespace CCHECKER {
+
+CertCache::CertCache(size_t max_entries) :
+    m_max_entries(max_entries),
+    m_hits(0),
+    m_misses(0),
+    m_failures(0)
+{}
+
+parsed_cert_ptr CertCache::parse(const std::string &der)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(der.data());
+    std::shared_ptr<X509> x509(d2i_X509(NULL, &p, der.size()), X509_free);
+    if (!x509)
+        return parsed_cert_ptr();
+
+    std::shared_ptr<parsed_cert_t> cert = std::make_shared<parsed_cert_t>();
+    cert->x509 = x509;
+    cert->subject = name_oneline(X509_get_subject_name(x509.get()));
+    cert->issuer = name_oneline(X509_get_issuer_name(x509.get()));
+
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int len = 0;
+    if (!X509_NAME_digest(X509_get_subject_name(x509.get()), EVP_sha1(), md, &len))
+        return parsed_cert_ptr();
+    cert->name_hash.assign(reinterpret_cast<char*>(md), len);
+    if (!X509_pubkey_digest(x509.get(), EVP_sha1(), md, &len))
+        return parsed_cert_ptr();
+    cert->key_hash.assign(reinterpret_cast<char*>(md), len);
+
+    const ASN1_INTEGER *serial = X509_get_serialNumber(x509.get());
+    cert->serial.assign(reinterpret_cast<const char*>(ASN1_STRING_get0_data(serial)),
+            ASN1_STRING_length(serial));
+    unsigned char *serial_der = NULL;
+    int serial_len = i2d_ASN1_INTEGER(const_cast<ASN1_INTEGER*>(serial), &serial_der);
+    if (serial_len <= 0)
+        return parsed_cert_ptr();
+    cert->serial_der.assign(reinterpret_cast<char*>(serial_der), serial_len);
+    OPENSSL_free(serial_der);
+
+    STACK_OF(OPENSSL_STRING) *urls = X509_get1_ocsp(x509.get());
+    if (urls) {
+        if (sk_OPENSSL_STRING_num(urls) > 0)
+            cert->ocsp_url = sk_OPENSSL_STRING_value(urls, 0);
+        X509_email_free(urls);
+    }
+
+    return cert;
+}
+
+parsed_cert_ptr CertCache::get(const certificate_t &cert)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(cert.sha256);
+        if (it != m_entries.end()) {
+            ++m_hits;
+            return it->second;
+        }
+        ++m_misses;
+    }
+
+    // Parsed without lock - same certificate may be parsed twice, first
+    // one wins
+    parsed_cert_ptr parsed = parse(cert.der);
+    if (!parsed)
+        LogError("Cannot parse certificate");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!parsed)
+        ++m_failures;
+    if (m_entries.size() >= m_max_entries)
+        evict();
+    // Failures are kept as well, not to parse them again
+    return m_entries.insert(std::make_pair(cert.sha256, parsed)).first->second;
+}
+
+CertCache::stats_t CertCache::stats(void) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats_t stats;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.failures = m_failures;
+    stats.entries = m_entries.size();
+    return stats;
+}
+
+// Entries still used by someone are kept, the cache may grow above limit
+void CertCache::evict(void)
+{
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->second.use_count() <= 1)
+            it = m_entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+} // CCHECKER
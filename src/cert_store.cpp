@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        cert_store.cpp
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Content-addressed store of certificates shared by apps
+ */
+#include <algorithm>
+
+#include <openssl/sha.h>
+
+#include <cert_store.h>
+
+namespace {
+
+// Expired entries are removed when the map doubles since the last purge
+const size_t MIN_PURGE_SIZE = 64;
+
+} //anonymus
+
+namespace CCHECKER {
+
+CertStore::CertStore(void) :
+    m_purge_at(MIN_PURGE_SIZE)
+{}
+
+CertStore &CertStore::instance(void)
+{
+    static CertStore store;
+    return store;
+}
+
+std::string CertStore::sha256(const char *data, size_t size)
+{
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char *>(data), size, digest);
+    return std::string(reinterpret_cast<const char *>(digest), sizeof(digest));
+}
+
+cert_ptr CertStore::intern(const std::string &der)
+{
+    // Hashed before locking, it's the costly part
+    std::string digest = sha256(der.data(), der.size());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    cert_ptr cert = find(digest);
+    if (cert)
+        return cert;
+    return insert(digest, der.data(), der.size());
+}
+
+cert_ptr CertStore::intern(const std::string &sha256, const char *der, size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    cert_ptr cert = find(sha256);
+    if (cert)
+        return cert;
+    return insert(sha256, der, size);
+}
+
+size_t CertStore::size(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    purge();
+    return m_certs.size();
+}
+
+cert_ptr CertStore::find(const std::string &sha256)
+{
+    auto it = m_certs.find(sha256);
+    if (it == m_certs.end())
+        return cert_ptr();
+    return it->second.lock();
+}
+
+cert_ptr CertStore::insert(const std::string &sha256, const char *der, size_t size)
+{
+    std::shared_ptr<certificate_t> cert = std::make_shared<certificate_t>();
+    cert->der.assign(der, size);
+    cert->sha256 = sha256;
+
+    m_certs[sha256] = cert;
+    if (m_certs.size() >= m_purge_at)
+        purge();
+    return cert;
+}
+
+void CertStore::purge(void)
+{
+    for (auto it = m_certs.begin(); it != m_certs.end();) {
+        if (it->second.expired())
+            it = m_certs.erase(it);
+        else
+            ++it;
+    }
+    m_purge_at = std::max(MIN_PURGE_SIZE, 2 * m_certs.size());
+}
+
+} // CCHECKER
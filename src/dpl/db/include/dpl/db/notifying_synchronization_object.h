@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        notifying_synchronization_object.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       This file is the header file of SQL synchronization object
+ * which wakes up waiting connections
+ */
+#ifndef CCHECKER_NOTIFYING_SYNCHRONIZATION_OBJECT_H
+#define CCHECKER_NOTIFYING_SYNCHRONIZATION_OBJECT_H
+
+#include <dpl/db/sql_connection.h>
+#include <stdint.h>
+
+namespace CCHECKER {
+namespace DB {
+/**
+ * Synchronization object used to synchronize SQL connections
+ * to the same database across different threads and processes
+ *
+ * Busy connections of one process wait on a shared condition variable
+ * and are woken up as soon as any other connection finishes its access.
+ * Because connections of other processes can't notify, every wait is
+ * bounded by a timeout, which grows exponentially with each consecutive
+ * busy retry of the calling thread.
+ */
+class NotifyingSynchronizationObject :
+    public SqlConnection::SynchronizationObject
+{
+  public:
+    // Bucket i counts waits shorter than 2^i ms, the last one all longer
+    static const unsigned int HISTOGRAM_BUCKETS = 8;
+
+    struct Statistics
+    {
+        uint64_t contentions; // Synchronize() calls
+        uint64_t notified;    // waits ended by NotifyAll()
+        uint64_t timeouts;    // waits ended by backoff timeout
+        uint64_t waitHistogram[HISTOGRAM_BUCKETS];
+    };
+
+    /**
+     * Contention statistics of all synchronization objects of the process
+     */
+    static Statistics GetStatistics();
+
+    // [SqlConnection::SynchronizationObject]
+    virtual void Synchronize();
+    virtual void NotifyAll();
+};
+} // namespace DB
+} // namespace CCHECKER
+
+#endif // CCHECKER_NOTIFYING_SYNCHRONIZATION_OBJECT_H
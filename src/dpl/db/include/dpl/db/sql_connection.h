@@ -32,6 +32,7 @@
 #include <dpl/assert.h>
 #include <memory>
 #include <stdint.h>
+#include <unordered_map>
 
 #include <log.h>
 
@@ -59,6 +60,39 @@ class SqlConnection
     typedef int ColumnIndex;
     typedef int ArgumentIndex;
 
+    /*
+     * Column content owned by SQLite - valid until the next Step() or
+     * Reset() of the data command or until it is destroyed
+     */
+    struct TextView
+    {
+        const char *data;
+        size_t size;
+    };
+
+    struct BlobView
+    {
+        const unsigned char *data;
+        size_t size;
+    };
+
+    /*
+     * Storage of a C++ type in a column, ColumnTraits<T> tells how values
+     * of type T are bound and read by DataCommand::BindAll/StepRow
+     */
+    enum ColumnKind
+    {
+        ColumnInteger,
+        ColumnBytes     // TEXT or BLOB
+    };
+
+    template <typename T>
+    struct ColumnTraits;
+
+  protected:
+    struct CachedStatement;
+
+  public:
     /*
      * SQL processed data command
      */
@@ -68,13 +102,43 @@ class SqlConnection
       private:
         SqlConnection *m_masterConnection;
         sqlite3_stmt *m_stmt;
+        CachedStatement *m_cachedStatement;
+        bool m_argumentsChecked;
+        bool m_columnsChecked;
 
         void CheckBindResult(int result);
         void CheckColumnIndex(SqlConnection::ColumnIndex column);
+        void CheckArgumentsCount(int count);
+        void CheckColumnKinds(const ColumnKind *kinds, int count);
+
+        void BindArguments(ArgumentIndex)
+        {}
 
-        DataCommand(SqlConnection *connection, const char *buffer);
+        template <typename T, typename... Rest>
+        void BindArguments(ArgumentIndex position,
+                           const T &value,
+                           const Rest &... rest)
+        {
+            CheckBindResult(ColumnTraits<T>::Bind(m_stmt, position, value));
+            BindArguments(position + 1, rest...);
+        }
+
+        void ReadColumns(ColumnIndex)
+        {}
+
+        template <typename T, typename... Rest>
+        void ReadColumns(ColumnIndex column, T &value, Rest &... rest)
+        {
+            ColumnTraits<T>::Read(m_stmt, column, value);
+            ReadColumns(column + 1, rest...);
+        }
+
+        DataCommand(SqlConnection *connection,
+                    const char *buffer,
+                    CachedStatement *cachedStatement = NULL);
 
         friend class SqlConnection;
+        friend struct DataCommandDeleter;
 
       public:
         virtual ~DataCommand();
@@ -158,6 +222,29 @@ class SqlConnection
          */
         void BindString(ArgumentIndex position, const String& value);
 
+        /**
+         * Bind blob to the prepared statement argument
+         *
+         * @param position Index of argument to bind value to
+         * @param value Value to bind
+         */
+        void BindBlob(ArgumentIndex position, const std::string &value);
+
+        /**
+         * Bind blob to the prepared statement argument without copying it
+         *
+         * Value has to stay unchanged until the statement is stepped for
+         * the last time with this binding.
+         *
+         * @param position Index of argument to bind value to
+         * @param data Value to bind
+         * @param size Size of value in bytes
+         */
+        void BindBlobStatic(ArgumentIndex position,
+                            const void *data,
+                            size_t size);
+        void BindBlobStatic(ArgumentIndex position, const std::string &value);
+
         /**
          * Bind optional int to the prepared statement argument.
          * If optional is not set null will be bound
@@ -238,6 +325,55 @@ class SqlConnection
          */
         bool Step();
 
+        /**
+         * Bind all arguments of the prepared statement at once, in order
+         *
+         * Number of arguments is checked on first call only. Strings are
+         * bound as text and copied, views are bound without copying and
+         * have to stay valid until the statement is stepped.
+         *
+         * @throw Exception::SyntaxError
+         */
+        template <typename... Args>
+        void BindAll(const Args &... args)
+        {
+            if (!m_argumentsChecked) {
+                CheckArgumentsCount(sizeof...(Args));
+                m_argumentsChecked = true;
+            }
+
+            BindArguments(1, args...);
+        }
+
+        /**
+         * Move to the next row of the result and read all its columns
+         *
+         * Number of columns and their declared types are checked against
+         * values on first call only, so a statement has to be always read
+         * into the same types. Columns are then read without any checks.
+         *
+         * @return True when there was a row returned
+         * @throw Exception::InvalidColumn
+         */
+        template <typename T, typename... Rest>
+        bool StepRow(T &value, Rest &... rest)
+        {
+            if (!m_columnsChecked) {
+                const ColumnKind kinds[] = {
+                    ColumnTraits<T>::kind, ColumnTraits<Rest>::kind...
+                };
+                CheckColumnKinds(kinds, 1 + sizeof...(Rest));
+                m_columnsChecked = true;
+            }
+
+            if (!Step()) {
+                return false;
+            }
+
+            ReadColumns(0, value, rest...);
+            return true;
+        }
+
         /**
          * Reset prepared statement's arguments
          * All parameters will become null
@@ -306,6 +442,29 @@ class SqlConnection
          */
         std::string GetColumnString(ColumnIndex column);
 
+        /**
+         * Get blob value from column in current row.
+         *
+         * @throw Exception::InvalidColumn
+         */
+        std::string GetColumnBlob(ColumnIndex column);
+
+        /**
+         * Get text value from column in current row, without copying it.
+         * NULL gives empty view.
+         *
+         * @throw Exception::InvalidColumn
+         */
+        TextView GetColumnTextView(ColumnIndex column);
+
+        /**
+         * Get blob value from column in current row, without copying it.
+         * NULL gives empty view.
+         *
+         * @throw Exception::InvalidColumn
+         */
+        BlobView GetColumnBlobView(ColumnIndex column);
+
         /**
          * Get optional integer value from column in current row.
          *
@@ -363,8 +522,49 @@ class SqlConnection
         Optional<String> GetColumnOptionalString(ColumnIndex column);
     };
 
-    // Move on copy semantics
-    typedef std::auto_ptr<DataCommand> DataCommandAutoPtr;
+    /*
+     * Deletes data command, or gives it back to the statement cache of its
+     * connection if it came from there
+     */
+    struct DataCommandDeleter
+    {
+        void operator()(DataCommand *command) const;
+    };
+
+    // Move only
+    typedef std::unique_ptr<DataCommand, DataCommandDeleter>
+        DataCommandUniquePtr;
+
+    /*
+     * Transaction guard, rolls back unless committed
+     *
+     * Outermost guard of a connection begins a real transaction, nested
+     * ones use savepoints, so an inner failure can be rolled back without
+     * losing outer changes. Guards have to be destroyed in reverse order.
+     */
+    class ScopedTransaction :
+        private Noncopyable
+    {
+      public:
+        enum Type
+        {
+            Deferred,   // Locks database on first access
+            Immediate,  // Takes write lock at once
+            Exclusive   // Blocks readers too (not in WAL mode)
+        };
+
+        explicit ScopedTransaction(SqlConnection *connection,
+                                   Type type = Deferred);
+        ~ScopedTransaction();
+
+        void Commit();
+        void Rollback();
+
+      private:
+        SqlConnection *m_connection;
+        int m_depth;
+        bool m_finished;
+    };
 
     // Open flags
     class Flag
@@ -387,6 +587,51 @@ class SqlConnection
                 SQLITE_OPEN_CREATE,
             CRW = RW | SQLITE_OPEN_CREATE
         };
+
+        enum Journal
+        {
+            JournalDefault,  // Rollback journal, as set in database file
+            JournalWal       // Write-ahead log, persistent in database file
+        };
+
+        enum Synchronous
+        {
+            SynchronousFull,   // Sync on every commit (SQLite default)
+            SynchronousNormal, // With WAL: sync on checkpoint only
+            SynchronousOff
+        };
+
+        /**
+         * Connection tuning, applied once after the database is opened.
+         * Zero leaves SQLite default for every numeric option.
+         */
+        struct Pragmas
+        {
+            Journal journal;
+            Synchronous synchronous;
+            int pageSize;            // bytes, only for a new database
+            int cacheSize;           // pages if positive, KiB if negative
+            sqlite3_int64 mmapSize;  // bytes
+            int walAutoCheckpoint;   // WAL pages, negative disables
+            sqlite3_int64 journalSizeLimit; // bytes, negative - no limit
+
+            Pragmas() :
+                journal(JournalDefault),
+                synchronous(SynchronousFull),
+                pageSize(0),
+                cacheSize(0),
+                mmapSize(0),
+                walAutoCheckpoint(0),
+                journalSizeLimit(0)
+            {}
+        };
+
+        enum Checkpoint
+        {
+            CheckpointPassive = SQLITE_CHECKPOINT_PASSIVE,
+            CheckpointFull = SQLITE_CHECKPOINT_FULL,
+            CheckpointRestart = SQLITE_CHECKPOINT_RESTART
+        };
     };
 
     // RowID
@@ -421,14 +666,36 @@ class SqlConnection
     // Stored data procedures
     int m_dataCommandsCount;
 
+    // Open transaction guards
+    int m_transactionDepth;
+
+    /*
+     * Prepared statement kept by the connection between uses, together
+     * with its data command, so reusing it doesn't allocate
+     */
+    struct CachedStatement
+    {
+        std::string sql;
+        std::unique_ptr<DataCommand> command;
+        bool inUse;
+    };
+
+    // Prepared statements cache, keyed by hash of SQL text
+    typedef std::unordered_multimap<size_t, CachedStatement> StatementCache;
+    StatementCache m_statementCache;
+
+    void ClearStatementCache();
+
     // Synchronization object
     std::unique_ptr<SynchronizationObject> m_synchronizationObject;
 
     virtual void Connect(const std::string &address,
-                         Flag::Type = Flag::None, Flag::Option = Flag::RO);
+                         Flag::Type = Flag::None, Flag::Option = Flag::RO,
+                         const Flag::Pragmas &pragmas = Flag::Pragmas());
     virtual void Disconnect();
 
     void TurnOnForeignKeys();
+    void SetPragmas(const Flag::Pragmas &pragmas);
 
     static SynchronizationObject *AllocDefaultSynchronizationObject();
 
@@ -443,11 +710,13 @@ class SqlConnection
      *
      * @param address Database file name
      * @param flags Open flags
+     * @param pragmas Connection tuning
      * @param synchronizationObject A synchronization object to use.
      */
     explicit SqlConnection(const std::string &address = std::string(),
                            Flag::Type flags = Flag::None,
                            Flag::Option options = Flag::RO,
+                           const Flag::Pragmas &pragmas = Flag::Pragmas(),
                            SynchronizationObject *synchronizationObject =
                                AllocDefaultSynchronizationObject());
 
@@ -459,6 +728,9 @@ class SqlConnection
     /**
      * Execute SQL command without result
      *
+     * SQL is formatted and parsed on every call - use Execute() unless
+     * the statement can't take parameters (e.g. PRAGMA, schema changes).
+     *
      * @param format
      * @param ...
      */
@@ -467,10 +739,71 @@ class SqlConnection
     /**
      * Prepare stored procedure
      *
+     * SQL is formatted and parsed on every call - use Query() unless
+     * the statement can't take parameters.
+     *
      * @param format SQL statement
      * @return Data command representing stored procedure
      */
-    DataCommandAutoPtr PrepareDataCommand(const char *format, ...);
+    DataCommandUniquePtr PrepareDataCommand(const char *format, ...);
+
+    /**
+     * Execute fixed SQL statement with given parameters, ignoring its
+     * result rows
+     *
+     * Statement comes from the statement cache, so it's parsed on first
+     * use only. Parameters are bound in order, see DataCommand::BindAll.
+     *
+     * @param sql SQL statement with '?' placeholders
+     * @param args Parameters
+     */
+    template <typename... Args>
+    void Execute(const char *sql, const Args &... args)
+    {
+        DataCommandUniquePtr command = PrepareCachedDataCommand(sql);
+        if (!command) {
+            return;
+        }
+
+        command->BindAll(args...);
+        while (command->Step()) {}
+    }
+
+    /**
+     * Get fixed SQL statement with given parameters bound, ready to be
+     * stepped
+     *
+     * Statement comes from the statement cache, so it's parsed on first
+     * use only. Parameters are bound in order, see DataCommand::BindAll.
+     *
+     * @param sql SQL statement with '?' placeholders
+     * @param args Parameters
+     * @return Data command representing stored procedure
+     */
+    template <typename... Args>
+    DataCommandUniquePtr Query(const char *sql, const Args &... args)
+    {
+        DataCommandUniquePtr command = PrepareCachedDataCommand(sql);
+        if (command) {
+            command->BindAll(args...);
+        }
+
+        return command;
+    }
+
+    /**
+     * Get prepared statement for given SQL text from statement cache
+     *
+     * Statement is prepared on first use only. When returned pointer is
+     * destroyed, statement is reset, its bindings are cleared and it goes
+     * back to the cache. Cached statements are finalized on
+     * disconnect. If statement for the same SQL is already in use, a new,
+     * uncached one is prepared.
+     *
+     * @param sql SQL statement, not formatted
+     * @return Data command representing stored procedure
+     */
+    DataCommandUniquePtr PrepareCachedDataCommand(const char *sql);
 
     /**
      * Check whether given table exists
@@ -480,6 +813,15 @@ class SqlConnection
      */
     bool CheckTableExist(const char *tableName);
 
+    /**
+     * Copy write-ahead log content into the database file
+     *
+     * Does nothing if the database is not in WAL mode.
+     *
+     * @param mode Checkpoint mode, see sqlite3_wal_checkpoint_v2
+     */
+    void Checkpoint(Flag::Checkpoint mode = Flag::CheckpointPassive);
+
     /**
      * Get last insert operation new row id
      *
@@ -487,6 +829,147 @@ class SqlConnection
      */
     RowID GetLastInsertRowID() const;
 };
+
+template <>
+struct SqlConnection::ColumnTraits<int>
+{
+    static const ColumnKind kind = ColumnInteger;
+
+    static int Bind(sqlite3_stmt *stmt, int position, int value)
+    {
+        return sqlite3_bind_int(stmt, position, value);
+    }
+
+    static void Read(sqlite3_stmt *stmt, int column, int &value)
+    {
+        value = sqlite3_column_int(stmt, column);
+    }
+};
+
+template <>
+struct SqlConnection::ColumnTraits<unsigned int>
+{
+    static const ColumnKind kind = ColumnInteger;
+
+    static int Bind(sqlite3_stmt *stmt, int position, unsigned int value)
+    {
+        return sqlite3_bind_int64(stmt, position, value);
+    }
+
+    static void Read(sqlite3_stmt *stmt, int column, unsigned int &value)
+    {
+        value = static_cast<unsigned int>(sqlite3_column_int64(stmt, column));
+    }
+};
+
+template <>
+struct SqlConnection::ColumnTraits<long>
+{
+    static const ColumnKind kind = ColumnInteger;
+
+    static int Bind(sqlite3_stmt *stmt, int position, long value)
+    {
+        return sqlite3_bind_int64(stmt, position, value);
+    }
+
+    static void Read(sqlite3_stmt *stmt, int column, long &value)
+    {
+        value = static_cast<long>(sqlite3_column_int64(stmt, column));
+    }
+};
+
+template <>
+struct SqlConnection::ColumnTraits<long long>
+{
+    static const ColumnKind kind = ColumnInteger;
+
+    static int Bind(sqlite3_stmt *stmt, int position, long long value)
+    {
+        return sqlite3_bind_int64(stmt, position, value);
+    }
+
+    static void Read(sqlite3_stmt *stmt, int column, long long &value)
+    {
+        value = sqlite3_column_int64(stmt, column);
+    }
+};
+
+template <>
+struct SqlConnection::ColumnTraits<std::string>
+{
+    static const ColumnKind kind = ColumnBytes;
+
+    static int Bind(sqlite3_stmt *stmt, int position, const std::string &value)
+    {
+        return sqlite3_bind_text(stmt, position, value.data(),
+                                 static_cast<int>(value.size()),
+                                 SQLITE_TRANSIENT);
+    }
+
+    // Both text and blob columns, embedded zeros are kept
+    static void Read(sqlite3_stmt *stmt, int column, std::string &value)
+    {
+        const char *data = static_cast<const char *>(
+                sqlite3_column_blob(stmt, column));
+        // Size has to be taken after sqlite3_column_blob()
+        int size = sqlite3_column_bytes(stmt, column);
+
+        if (data == NULL) {
+            value.clear();
+        } else {
+            value.assign(data, size);
+        }
+    }
+};
+
+template <>
+struct SqlConnection::ColumnTraits<SqlConnection::TextView>
+{
+    static const ColumnKind kind = ColumnBytes;
+
+    static int Bind(sqlite3_stmt *stmt, int position, const TextView &value)
+    {
+        return sqlite3_bind_text(stmt, position, value.data,
+                                 static_cast<int>(value.size), SQLITE_STATIC);
+    }
+
+    static void Read(sqlite3_stmt *stmt, int column, TextView &value)
+    {
+        value.data = reinterpret_cast<const char *>(
+                sqlite3_column_text(stmt, column));
+        // Size has to be taken after sqlite3_column_text()
+        value.size = static_cast<size_t>(sqlite3_column_bytes(stmt, column));
+
+        if (value.data == NULL) {
+            value.data = "";
+            value.size = 0;
+        }
+    }
+};
+
+template <>
+struct SqlConnection::ColumnTraits<SqlConnection::BlobView>
+{
+    static const ColumnKind kind = ColumnBytes;
+
+    static int Bind(sqlite3_stmt *stmt, int position, const BlobView &value)
+    {
+        return sqlite3_bind_blob(stmt, position, value.data,
+                                 static_cast<int>(value.size), SQLITE_STATIC);
+    }
+
+    static void Read(sqlite3_stmt *stmt, int column, BlobView &value)
+    {
+        value.data = static_cast<const unsigned char *>(
+                sqlite3_column_blob(stmt, column));
+        // Size has to be taken after sqlite3_column_blob()
+        value.size = static_cast<size_t>(sqlite3_column_bytes(stmt, column));
+
+        if (value.data == NULL) {
+            value.size = 0;
+        }
+    }
+};
 } // namespace DB
 } // namespace CCHECKER
 
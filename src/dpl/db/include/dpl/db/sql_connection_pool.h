@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        sql_connection_pool.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       This file is the header file of SQL connection pool
+ */
+#ifndef CCHECKER_SQL_CONNECTION_POOL_H
+#define CCHECKER_SQL_CONNECTION_POOL_H
+
+#include <dpl/db/sql_connection.h>
+#include <dpl/noncopyable.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace CCHECKER {
+namespace DB {
+/**
+ * Connections to the same database shared by many threads
+ *
+ * One read-write connection and a number of read-only ones. Each
+ * connection is used by one thread at a time - it is leased to the
+ * thread and goes back to the pool when the lease is destroyed. If all
+ * connections of requested kind are leased, caller waits.
+ *
+ * Readers run in parallel with the writer only if database is in WAL
+ * mode. They don't see changes of writer's open transaction.
+ */
+class SqlConnectionPool :
+    private Noncopyable
+{
+  public:
+    class Lease :
+        private Noncopyable
+    {
+      public:
+        Lease(Lease &&other);
+        ~Lease();
+
+        SqlConnection *Get() const
+        {
+            return m_connection;
+        }
+
+        SqlConnection *operator->() const
+        {
+            return m_connection;
+        }
+
+        SqlConnection &operator*() const
+        {
+            return *m_connection;
+        }
+
+      private:
+        friend class SqlConnectionPool;
+
+        Lease(SqlConnectionPool *pool, SqlConnection *connection);
+
+        SqlConnectionPool *m_pool;
+        SqlConnection *m_connection;
+    };
+
+    /**
+     * Opens writer and all readers
+     *
+     * Writer is opened first, so it may create the database and set up
+     * its journal mode. Readers get the same pragmas, except for the ones
+     * that modify the database file.
+     *
+     * @param address Database file name
+     * @param readers Number of read-only connections
+     * @param pragmas Connection tuning
+     */
+    SqlConnectionPool(const std::string &address,
+                      size_t readers,
+                      const SqlConnection::Flag::Pragmas &pragmas =
+                          SqlConnection::Flag::Pragmas());
+    ~SqlConnectionPool();
+
+    Lease GetWriter();
+    Lease GetReader();
+
+    size_t ReadersCount() const;
+
+  private:
+    void Return(SqlConnection *connection);
+
+    std::unique_ptr<SqlConnection> m_writer;
+    std::vector<std::unique_ptr<SqlConnection> > m_readers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_returned;
+    bool m_writerLeased;
+    std::vector<SqlConnection *> m_freeReaders;
+};
+} // namespace DB
+} // namespace CCHECKER
+
+#endif // CCHECKER_SQL_CONNECTION_POOL_H
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        notifying_synchronization_object.cpp
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       This file is the implementation file of SQL synchronization
+ * object which wakes up waiting connections
+ */
+#include <stddef.h>
+#include <dpl/db/notifying_synchronization_object.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+
+namespace {
+// Backoff: 1ms, 2ms, 4ms ... up to 32ms
+const unsigned int INITIAL_TIMEOUT_MS = 1;
+const unsigned int MAX_BACKOFF_SHIFT = 5;
+
+// Shared by all connections of the process
+struct SharedState
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    uint64_t generation;
+    std::atomic<unsigned int> waiters;
+    CCHECKER::DB::NotifyingSynchronizationObject::Statistics stats;
+
+    SharedState() :
+        generation(0),
+        waiters(0)
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+};
+
+SharedState &GetSharedState()
+{
+    static SharedState state;
+    return state;
+}
+
+// Consecutive busy retries of this thread, cleared after successful access
+thread_local unsigned int attempt = 0;
+} // namespace anonymous
+
+namespace CCHECKER {
+namespace DB {
+NotifyingSynchronizationObject::Statistics
+NotifyingSynchronizationObject::GetStatistics()
+{
+    SharedState &state = GetSharedState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.stats;
+}
+
+void NotifyingSynchronizationObject::Synchronize()
+{
+    SharedState &state = GetSharedState();
+    std::chrono::milliseconds timeout(INITIAL_TIMEOUT_MS << attempt);
+    if (attempt < MAX_BACKOFF_SHIFT) {
+        ++attempt;
+    }
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(state.mutex);
+    uint64_t generation = state.generation;
+    ++state.waiters;
+    bool notified = state.cond.wait_for(lock, timeout, [&] {
+        return state.generation != generation;
+    });
+    --state.waiters;
+
+    uint64_t waitedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    unsigned int bucket = 0;
+    while (bucket < HISTOGRAM_BUCKETS - 1 && waitedMs >= (1ull << bucket)) {
+        ++bucket;
+    }
+
+    ++state.stats.contentions;
+    ++(notified ? state.stats.notified : state.stats.timeouts);
+    ++state.stats.waitHistogram[bucket];
+}
+
+void NotifyingSynchronizationObject::NotifyAll()
+{
+    attempt = 0;
+
+    SharedState &state = GetSharedState();
+    if (state.waiters.load() == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        ++state.generation;
+    }
+    state.cond.notify_all();
+}
+} // namespace DB
+} // namespace CCHECKER
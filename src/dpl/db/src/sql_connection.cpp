@@ -21,12 +21,13 @@
  */
 #include <stddef.h>
 #include <dpl/db/sql_connection.h>
-#include <dpl/db/naive_synchronization_object.h>
+#include <dpl/db/notifying_synchronization_object.h>
 #include <dpl/scoped_free.h>
 #include <dpl/noncopyable.h>
 #include <dpl/assert.h>
 #include <db-util.h>
 #include <unistd.h>
+#include <cctype>
 #include <cstdio>
 #include <cstdarg>
 
@@ -59,9 +60,13 @@ class ScopedNotifyAll :
 } // namespace anonymous
 
 SqlConnection::DataCommand::DataCommand(SqlConnection *connection,
-                                        const char *buffer) :
+                                        const char *buffer,
+                                        CachedStatement *cachedStatement) :
     m_masterConnection(connection),
-    m_stmt(NULL)
+    m_stmt(NULL),
+    m_cachedStatement(cachedStatement),
+    m_argumentsChecked(false),
+    m_columnsChecked(false)
 {
     Assert(connection != NULL);
 
@@ -113,8 +118,27 @@ SqlConnection::DataCommand::~DataCommand()
         LogDebug("Failed to finalize data command");
     }
 
-    // Decrement stored data command count
-    --m_masterConnection->m_dataCommandsCount;
+    // Cached commands are counted while handed out only
+    if (m_cachedStatement == NULL) {
+        // Decrement stored data command count
+        --m_masterConnection->m_dataCommandsCount;
+    }
+}
+
+void SqlConnection::DataCommandDeleter::operator()(DataCommand *command) const
+{
+    if (command->m_cachedStatement == NULL) {
+        delete command;
+        return;
+    }
+
+    LogDebug("SQL data command returning to cache");
+
+    // Statement stays prepared, only its state is cleared
+    sqlite3_reset(command->m_stmt);
+    sqlite3_clear_bindings(command->m_stmt);
+    command->m_cachedStatement->inUse = false;
+    --command->m_masterConnection->m_dataCommandsCount;
 }
 
 void SqlConnection::DataCommand::CheckBindResult(int result)
@@ -231,6 +255,40 @@ void SqlConnection::DataCommand::BindString(
     BindString(position, ToUTF8String(value).c_str());
 }
 
+void SqlConnection::DataCommand::BindBlob(
+    SqlConnection::ArgumentIndex position,
+    const std::string &value)
+{
+    // Assume that blob may disappear
+    CheckBindResult(sqlite3_bind_blob(m_stmt, position,
+                                      value.data(), value.size(),
+                                      SQLITE_TRANSIENT));
+
+    LogDebug("SQL data command bind blob: ["
+                << position << "] -> " << value.size() << " bytes");
+}
+
+void SqlConnection::DataCommand::BindBlobStatic(
+    SqlConnection::ArgumentIndex position,
+    const void *data,
+    size_t size)
+{
+    // Caller keeps the blob alive
+    CheckBindResult(sqlite3_bind_blob(m_stmt, position,
+                                      data, static_cast<int>(size),
+                                      SQLITE_STATIC));
+
+    LogDebug("SQL data command bind static blob: ["
+                << position << "] -> " << size << " bytes");
+}
+
+void SqlConnection::DataCommand::BindBlobStatic(
+    SqlConnection::ArgumentIndex position,
+    const std::string &value)
+{
+    BindBlobStatic(position, value.data(), value.size());
+}
+
 void SqlConnection::DataCommand::BindInteger(
     SqlConnection::ArgumentIndex position,
     const Optional<int> &value)
@@ -383,6 +441,50 @@ void SqlConnection::DataCommand::CheckColumnIndex(
     }
 }
 
+void SqlConnection::DataCommand::CheckArgumentsCount(int count)
+{
+    int expected = sqlite3_bind_parameter_count(m_stmt);
+
+    if (count != expected) {
+        ThrowMsg(Exception::SyntaxError,
+                 "Statement takes " << expected << " arguments, "
+                 << count << " given");
+    }
+}
+
+void SqlConnection::DataCommand::CheckColumnKinds(const ColumnKind *kinds,
+                                                  int count)
+{
+    int expected = sqlite3_column_count(m_stmt);
+
+    if (count != expected) {
+        ThrowMsg(Exception::InvalidColumn,
+                 "Statement returns " << expected << " columns, "
+                 << count << " requested");
+    }
+
+    for (int column = 0; column < count; ++column) {
+        // Expressions have no declared type, they're not checked
+        const char *declared = sqlite3_column_decltype(m_stmt, column);
+        if (declared == NULL) {
+            continue;
+        }
+
+        // SQLite type affinity rules: INTEGER for names containing "INT"
+        std::string type(declared);
+        for (auto &c : type) {
+            c = toupper(static_cast<unsigned char>(c));
+        }
+        bool integer = type.find("INT") != std::string::npos;
+
+        if (integer != (kinds[column] == ColumnInteger)) {
+            ThrowMsg(Exception::InvalidColumn,
+                     "Column " << column << " of type " << declared
+                     << " read as " << (integer ? "text/blob" : "integer"));
+        }
+    }
+}
+
 bool SqlConnection::DataCommand::IsColumnNull(
     SqlConnection::ColumnIndex column)
 {
@@ -479,6 +581,65 @@ std::string SqlConnection::DataCommand::GetColumnString(
     return std::string(value);
 }
 
+std::string SqlConnection::DataCommand::GetColumnBlob(
+    SqlConnection::ColumnIndex column)
+{
+    LogDebug("SQL data command get column blob: [" << column << "]");
+    CheckColumnIndex(column);
+
+    const char *value = static_cast<const char *>(
+            sqlite3_column_blob(m_stmt, column));
+    // Size has to be taken after sqlite3_column_blob()
+    int size = sqlite3_column_bytes(m_stmt, column);
+
+    LogDebug("    Size: " << size);
+
+    if (value == NULL) {
+        return std::string();
+    }
+
+    return std::string(value, size);
+}
+
+SqlConnection::TextView SqlConnection::DataCommand::GetColumnTextView(
+    SqlConnection::ColumnIndex column)
+{
+    LogDebug("SQL data command get column text view: [" << column << "]");
+    CheckColumnIndex(column);
+
+    TextView view;
+    view.data = reinterpret_cast<const char *>(
+            sqlite3_column_text(m_stmt, column));
+    // Size has to be taken after sqlite3_column_text()
+    view.size = static_cast<size_t>(sqlite3_column_bytes(m_stmt, column));
+
+    if (view.data == NULL) {
+        view.data = "";
+        view.size = 0;
+    }
+
+    return view;
+}
+
+SqlConnection::BlobView SqlConnection::DataCommand::GetColumnBlobView(
+    SqlConnection::ColumnIndex column)
+{
+    LogDebug("SQL data command get column blob view: [" << column << "]");
+    CheckColumnIndex(column);
+
+    BlobView view;
+    view.data = static_cast<const unsigned char *>(
+            sqlite3_column_blob(m_stmt, column));
+    // Size has to be taken after sqlite3_column_blob()
+    view.size = static_cast<size_t>(sqlite3_column_bytes(m_stmt, column));
+
+    if (view.data == NULL) {
+        view.size = 0;
+    }
+
+    return view;
+}
+
 Optional<int> SqlConnection::DataCommand::GetColumnOptionalInteger(
     SqlConnection::ColumnIndex column)
 {
@@ -595,7 +756,8 @@ Optional<String> SqlConnection::DataCommand::GetColumnOptionalString(
 
 void SqlConnection::Connect(const std::string &address,
                             Flag::Type type,
-                            Flag::Option flag)
+                            Flag::Option flag,
+                            const Flag::Pragmas &pragmas)
 {
     if (m_connection != NULL) {
         LogDebug("Already connected.");
@@ -634,6 +796,8 @@ void SqlConnection::Connect(const std::string &address,
 
     // Enable foreign keys
     TurnOnForeignKeys();
+
+    SetPragmas(pragmas);
 }
 
 void SqlConnection::Disconnect()
@@ -650,6 +814,8 @@ void SqlConnection::Disconnect()
            "All stored procedures must be deleted"
            " before disconnecting SqlConnection");
 
+    ClearStatementCache();
+
     int result;
 
     if (m_usingLucene) {
@@ -677,10 +843,9 @@ bool SqlConnection::CheckTableExist(const char *tableName)
         return false;
     }
 
-    DataCommandAutoPtr command =
-        PrepareDataCommand("select tbl_name from sqlite_master where name=?;");
-
-    command->BindString(1, tableName);
+    TextView name = { tableName, strlen(tableName) };
+    DataCommandUniquePtr command =
+        Query("select tbl_name from sqlite_master where name=?;", name);
 
     if (!command->Step()) {
         LogDebug("No matching records in table");
@@ -693,16 +858,18 @@ bool SqlConnection::CheckTableExist(const char *tableName)
 SqlConnection::SqlConnection(const std::string &address,
                              Flag::Type flag,
                              Flag::Option option,
+                             const Flag::Pragmas &pragmas,
                              SynchronizationObject *synchronizationObject) :
     m_connection(NULL),
     m_usingLucene(false),
     m_dataCommandsCount(0),
+    m_transactionDepth(0),
     m_synchronizationObject(synchronizationObject)
 {
     LogDebug("Opening database connection to: " << address);
 
     // Connect to DB
-    SqlConnection::Connect(address, flag, option);
+    SqlConnection::Connect(address, flag, option, pragmas);
 
     if (!m_synchronizationObject) {
         LogDebug("No synchronization object defined");
@@ -799,13 +966,13 @@ void SqlConnection::ExecCommand(const char *format, ...)
     }
 }
 
-SqlConnection::DataCommandAutoPtr SqlConnection::PrepareDataCommand(
+SqlConnection::DataCommandUniquePtr SqlConnection::PrepareDataCommand(
     const char *format,
     ...)
 {
     if (m_connection == NULL) {
         LogDebug("Cannot execute data command. Not connected to DB!");
-        return DataCommandAutoPtr();
+        return DataCommandUniquePtr();
     }
 
     char *rawBuffer;
@@ -823,12 +990,163 @@ SqlConnection::DataCommandAutoPtr SqlConnection::PrepareDataCommand(
 
     if (!buffer) {
         LogDebug("Failed to allocate statement string");
-        return DataCommandAutoPtr();
+        return DataCommandUniquePtr();
     }
 
     LogDebug("Executing SQL data command: " << buffer.Get());
 
-    return DataCommandAutoPtr(new DataCommand(this, buffer.Get()));
+    return DataCommandUniquePtr(new DataCommand(this, buffer.Get()));
+}
+
+SqlConnection::DataCommandUniquePtr SqlConnection::PrepareCachedDataCommand(
+    const char *sql)
+{
+    if (m_connection == NULL) {
+        LogDebug("Cannot execute data command. Not connected to DB!");
+        return DataCommandUniquePtr();
+    }
+
+    if (sql == NULL) {
+        LogDebug("Null query!");
+        ThrowMsg(Exception::SyntaxError, "Null statement");
+    }
+
+    LogDebug("Executing cached SQL data command: " << sql);
+
+    // FNV-1a - lookup doesn't need to copy SQL text
+    size_t hash = 2166136261u;
+    for (const char *c = sql; *c != '\0'; ++c) {
+        hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+    }
+
+    bool inUse = false;
+    auto range = m_statementCache.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.sql != sql) {
+            continue;
+        }
+
+        if (it->second.inUse) {
+            inUse = true;
+            break;
+        }
+
+        it->second.inUse = true;
+        ++m_dataCommandsCount;
+        return DataCommandUniquePtr(it->second.command.get());
+    }
+
+    if (inUse) {
+        LogDebug("Cached statement in use, preparing a new one");
+        return DataCommandUniquePtr(new DataCommand(this, sql));
+    }
+
+    // Cache nodes are not moved on insert, so the pointer stays valid
+    auto it = m_statementCache.insert(
+            std::make_pair(hash, CachedStatement{sql, nullptr, true}));
+
+    try {
+        it->second.command.reset(new DataCommand(this, sql, &it->second));
+    } catch (...) {
+        m_statementCache.erase(it);
+        throw;
+    }
+
+    return DataCommandUniquePtr(it->second.command.get());
+}
+
+void SqlConnection::ClearStatementCache()
+{
+    for (auto &entry : m_statementCache) {
+        Assert(!entry.second.inUse &&
+               "Cached statements must be returned before disconnect");
+    }
+
+    // Finalizes statements
+    m_statementCache.clear();
+}
+
+SqlConnection::ScopedTransaction::ScopedTransaction(SqlConnection *connection,
+                                                    Type type) :
+    m_connection(connection),
+    m_depth(0),
+    m_finished(false)
+{
+    Assert(connection != NULL);
+
+    m_depth = m_connection->m_transactionDepth;
+
+    // Guards are strictly nested, so all savepoints may share one name -
+    // SQLite releases and rolls back to the most recent one
+    if (m_depth > 0) {
+        m_connection->Execute("SAVEPOINT sp;");
+    } else {
+        switch (type) {
+        case Immediate:
+            m_connection->Execute("BEGIN IMMEDIATE;");
+            break;
+        case Exclusive:
+            m_connection->Execute("BEGIN EXCLUSIVE;");
+            break;
+        case Deferred:
+            m_connection->Execute("BEGIN DEFERRED;");
+            break;
+        }
+    }
+
+    ++m_connection->m_transactionDepth;
+}
+
+SqlConnection::ScopedTransaction::~ScopedTransaction()
+{
+    if (m_finished) {
+        return;
+    }
+
+    Try
+    {
+        Rollback();
+    }
+    Catch(Exception::Base)
+    {
+        LogError("Failed to roll back transaction: "
+                 << _rethrown_exception.GetMessage());
+    }
+}
+
+void SqlConnection::ScopedTransaction::Commit()
+{
+    Assert(!m_finished && "Transaction already finished");
+    Assert(m_connection->m_transactionDepth == m_depth + 1 &&
+           "Nested transactions must be finished first");
+
+    if (m_depth > 0) {
+        m_connection->Execute("RELEASE sp;");
+    } else {
+        m_connection->Execute("COMMIT;");
+    }
+
+    m_finished = true;
+    --m_connection->m_transactionDepth;
+}
+
+void SqlConnection::ScopedTransaction::Rollback()
+{
+    Assert(!m_finished && "Transaction already finished");
+    Assert(m_connection->m_transactionDepth == m_depth + 1 &&
+           "Nested transactions must be finished first");
+
+    // Guard is finished even if rollback fails - SQLite rolls back
+    // a failed transaction on its own
+    m_finished = true;
+    --m_connection->m_transactionDepth;
+
+    if (m_depth > 0) {
+        m_connection->Execute("ROLLBACK TO sp;");
+        m_connection->Execute("RELEASE sp;");
+    } else {
+        m_connection->Execute("ROLLBACK;");
+    }
 }
 
 SqlConnection::RowID SqlConnection::GetLastInsertRowID() const
@@ -841,10 +1159,94 @@ void SqlConnection::TurnOnForeignKeys()
     ExecCommand("PRAGMA foreign_keys = ON;");
 }
 
+void SqlConnection::SetPragmas(const Flag::Pragmas &pragmas)
+{
+    // Page size has to be set before journal mode - it can't be changed
+    // in WAL mode
+    if (pragmas.pageSize > 0) {
+        ExecCommand("PRAGMA page_size = %d;", pragmas.pageSize);
+    }
+
+    if (pragmas.journal == Flag::JournalWal) {
+        DataCommandUniquePtr command =
+            PrepareDataCommand("PRAGMA journal_mode = WAL;");
+
+        // Returns the mode in effect, e.g. memory databases stay as they are
+        if (command->Step() &&
+            command->GetColumnString(0) != "wal")
+        {
+            LogWarning("Cannot switch database to WAL mode, journal mode: "
+                       << command->GetColumnString(0));
+        }
+    }
+
+    switch (pragmas.synchronous) {
+    case Flag::SynchronousNormal:
+        ExecCommand("PRAGMA synchronous = NORMAL;");
+        break;
+    case Flag::SynchronousOff:
+        ExecCommand("PRAGMA synchronous = OFF;");
+        break;
+    case Flag::SynchronousFull:
+        break;
+    }
+
+    if (pragmas.cacheSize != 0) {
+        ExecCommand("PRAGMA cache_size = %d;", pragmas.cacheSize);
+    }
+
+    if (pragmas.mmapSize > 0) {
+        ExecCommand("PRAGMA mmap_size = %lld;",
+                    static_cast<long long>(pragmas.mmapSize));
+    }
+
+    if (pragmas.walAutoCheckpoint != 0) {
+        sqlite3_wal_autocheckpoint(m_connection,
+                                   pragmas.walAutoCheckpoint > 0 ?
+                                   pragmas.walAutoCheckpoint : 0);
+    }
+
+    if (pragmas.journalSizeLimit != 0) {
+        ExecCommand("PRAGMA journal_size_limit = %lld;",
+                    static_cast<long long>(pragmas.journalSizeLimit));
+    }
+}
+
+void SqlConnection::Checkpoint(Flag::Checkpoint mode)
+{
+    if (m_connection == NULL) {
+        LogDebug("Cannot checkpoint. Not connected to DB!");
+        return;
+    }
+
+    int logFrames = 0;
+    int checkpointedFrames = 0;
+    int result = sqlite3_wal_checkpoint_v2(m_connection,
+                                           NULL,
+                                           mode,
+                                           &logFrames,
+                                           &checkpointedFrames);
+
+    if (result == SQLITE_BUSY) {
+        // Readers or another writer still use the log - try next time
+        LogDebug("Checkpoint not complete: " << checkpointedFrames
+                 << "/" << logFrames << " frames");
+        return;
+    }
+
+    if (result != SQLITE_OK) {
+        LogDebug("Checkpoint failed: " << sqlite3_errmsg(m_connection));
+        ThrowMsg(Exception::InternalError, sqlite3_errmsg(m_connection));
+    }
+
+    LogDebug("Checkpointed " << checkpointedFrames << "/" << logFrames
+             << " frames");
+}
+
 SqlConnection::SynchronizationObject *
 SqlConnection::AllocDefaultSynchronizationObject()
 {
-    return new NaiveSynchronizationObject();
+    return new NotifyingSynchronizationObject();
 }
 } // namespace DB
 } // namespace CCHECKER
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        sql_connection_pool.cpp
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       This file is the implementation file of SQL connection pool
+ */
+#include <stddef.h>
+#include <dpl/db/sql_connection_pool.h>
+#include <dpl/assert.h>
+
+namespace CCHECKER {
+namespace DB {
+SqlConnectionPool::Lease::Lease(SqlConnectionPool *pool,
+                                SqlConnection *connection) :
+    m_pool(pool),
+    m_connection(connection)
+{}
+
+SqlConnectionPool::Lease::Lease(Lease &&other) :
+    m_pool(other.m_pool),
+    m_connection(other.m_connection)
+{
+    other.m_pool = NULL;
+    other.m_connection = NULL;
+}
+
+SqlConnectionPool::Lease::~Lease()
+{
+    if (m_pool != NULL) {
+        m_pool->Return(m_connection);
+    }
+}
+
+SqlConnectionPool::SqlConnectionPool(const std::string &address,
+                                     size_t readers,
+                                     const SqlConnection::Flag::Pragmas &pragmas) :
+    m_writerLeased(false)
+{
+    LogDebug("Opening connection pool to: " << address
+             << " with " << readers << " readers");
+
+    m_writer.reset(new SqlConnection(address,
+                                     SqlConnection::Flag::None,
+                                     SqlConnection::Flag::RW,
+                                     pragmas));
+
+    // Journal mode, page size and WAL size are the writer's business
+    SqlConnection::Flag::Pragmas readerPragmas = pragmas;
+    readerPragmas.journal = SqlConnection::Flag::JournalDefault;
+    readerPragmas.pageSize = 0;
+    readerPragmas.walAutoCheckpoint = 0;
+    readerPragmas.journalSizeLimit = 0;
+
+    for (size_t i = 0; i < readers; ++i) {
+        m_readers.emplace_back(new SqlConnection(address,
+                                                 SqlConnection::Flag::None,
+                                                 SqlConnection::Flag::RO,
+                                                 readerPragmas));
+        m_freeReaders.push_back(m_readers.back().get());
+    }
+}
+
+SqlConnectionPool::~SqlConnectionPool()
+{
+    // All leases must be returned before the pool is destroyed
+    Assert(!m_writerLeased && m_freeReaders.size() == m_readers.size() &&
+           "All connections must be returned before destroying the pool");
+
+    // Readers go first - the last connection to WAL database checkpoints
+    m_freeReaders.clear();
+    m_readers.clear();
+    m_writer.reset();
+}
+
+SqlConnectionPool::Lease SqlConnectionPool::GetWriter()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_returned.wait(lock, [this] { return !m_writerLeased; });
+    m_writerLeased = true;
+
+    return Lease(this, m_writer.get());
+}
+
+SqlConnectionPool::Lease SqlConnectionPool::GetReader()
+{
+    // Without readers everything goes through the writer
+    if (m_readers.empty()) {
+        return GetWriter();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_returned.wait(lock, [this] { return !m_freeReaders.empty(); });
+    SqlConnection *connection = m_freeReaders.back();
+    m_freeReaders.pop_back();
+
+    return Lease(this, connection);
+}
+
+size_t SqlConnectionPool::ReadersCount() const
+{
+    return m_readers.size();
+}
+
+void SqlConnectionPool::Return(SqlConnection *connection)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (connection == m_writer.get()) {
+            m_writerLeased = false;
+        } else {
+            m_freeReaders.push_back(connection);
+        }
+    }
+    m_returned.notify_all();
+}
+} // namespace DB
+} // namespace CCHECKER
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        http_pool.cpp
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Keep-alive HTTP connections, pooled per host
+ */
+#include <algorithm>
+
+#include <http_pool.h>
+#include <log.h>
+
+namespace {
+
+const long HTTP_TIMEOUT_SEC = 30;
+const size_t MAX_RESPONSE_SIZE = 1024 * 1024;
+
+size_t write_callback(char *data, size_t size, size_t nmemb, void *userdata)
+{
+    std::string *body = static_cast<std::string*>(userdata);
+    size_t len = size * nmemb;
+    if (body->size() + len > MAX_RESPONSE_SIZE)
+        return 0; // Aborts transfer
+    body->append(data, len);
+    return len;
+}
+
+} //anonymus
+
+namespace CCHECKER {
+
+HttpPool::HttpPool(size_t max_per_host, std::chrono::seconds idle_timeout) :
+    m_max_per_host(std::max<size_t>(max_per_host, 1)),
+    m_idle_timeout(idle_timeout),
+    m_latency_pos(0),
+    m_requests(0),
+    m_reused(0),
+    m_failures(0),
+    m_waits(0)
+{
+    m_latencies.reserve(LATENCY_SAMPLES);
+}
+
+HttpPool::~HttpPool(void)
+{
+    for (auto &host : m_hosts)
+        for (auto &idle : host.second.idle)
+            curl_easy_cleanup(idle.curl);
+}
+
+// scheme://host:port - requests with the same key may share a connection
+std::string HttpPool::host_key(const std::string &url)
+{
+    size_t start = url.find("://");
+    start = (start == std::string::npos) ? 0 : start + 3;
+    return url.substr(0, url.find('/', start));
+}
+
+void HttpPool::expire(time_point_t now, std::vector<CURL*> &expired)
+{
+    for (auto it = m_hosts.begin(); it != m_hosts.end();) {
+        std::vector<idle_t> &idle = it->second.idle;
+        // Least recently used are at the front
+        auto end = idle.begin();
+        while (end != idle.end() && now - end->since >= m_idle_timeout)
+            expired.push_back((end++)->curl);
+        idle.erase(idle.begin(), end);
+
+        if (idle.empty() && it->second.active == 0)
+            it = m_hosts.erase(it);
+        else
+            ++it;
+    }
+}
+
+void HttpPool::add_latency(uint64_t latency_us)
+{
+    if (m_latencies.size() < LATENCY_SAMPLES) {
+        m_latencies.push_back(latency_us);
+    } else {
+        m_latencies[m_latency_pos] = latency_us;
+        m_latency_pos = (m_latency_pos + 1) % LATENCY_SAMPLES;
+    }
+}
+
+bool HttpPool::post(const std::string &url,
+                    const char *content_type,
+                    const std::string &body,
+                    std::string &response)
+{
+    std::string key = host_key(url);
+    std::vector<CURL*> expired;
+    CURL *curl = NULL;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_hosts[key].active >= m_max_per_host) {
+            ++m_waits;
+            m_cv.wait(lock, [&] { return m_hosts[key].active < m_max_per_host; });
+        }
+
+        expire(std::chrono::steady_clock::now(), expired);
+        host_t &host = m_hosts[key];
+        ++host.active;
+        if (!host.idle.empty()) {
+            curl = host.idle.back().curl;
+            host.idle.pop_back();
+        }
+    }
+
+    // Closed without the lock, it may have to say goodbye to a server
+    for (auto handle : expired)
+        curl_easy_cleanup(handle);
+
+    // Reset keeps the connection open
+    if (curl)
+        curl_easy_reset(curl);
+    else
+        curl = curl_easy_init();
+
+    CURLcode res = CURLE_FAILED_INIT;
+    long http_code = 0;
+    long connects = 0;
+    time_point_t start = std::chrono::steady_clock::now();
+    if (curl) {
+        struct curl_slist *headers = NULL;
+        std::string header = std::string("Content-Type: ") + content_type;
+        headers = curl_slist_append(headers, header.c_str());
+
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.data());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, HTTP_TIMEOUT_SEC);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+#if LIBCURL_VERSION_NUM >= 0x074100
+        // Connection idle longer than handle would be is not reused either
+        curl_easy_setopt(curl, CURLOPT_MAXAGE_CONN, static_cast<long>(m_idle_timeout.count()));
+#endif
+
+        res = curl_easy_perform(curl);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+
+        curl_slist_free_all(headers);
+    } else {
+        LogError("curl_easy_init failed");
+    }
+
+    bool ok = (res == CURLE_OK && http_code == 200);
+    uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+    // Handle that failed may have its connection broken, it isn't kept
+    CURL *broken = NULL;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        host_t &host = m_hosts[key];
+        --host.active;
+        if (res == CURLE_OK)
+            host.idle.push_back(idle_t{curl, std::chrono::steady_clock::now()});
+        else
+            broken = curl;
+
+        ++m_requests;
+        if (res == CURLE_OK && connects == 0)
+            ++m_reused;
+        if (!ok)
+            ++m_failures;
+        add_latency(latency);
+    }
+    m_cv.notify_all();
+
+    if (broken)
+        curl_easy_cleanup(broken);
+
+    if (res != CURLE_OK) {
+        LogError("HTTP request to " << url << " failed: " << curl_easy_strerror(res));
+        return false;
+    }
+    if (http_code != 200) {
+        LogError("Server " << url << " returned HTTP " << http_code);
+        return false;
+    }
+    return true;
+}
+
+void HttpPool::close_idle(void)
+{
+    std::vector<CURL*> expired;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        expire(std::chrono::steady_clock::now(), expired);
+    }
+
+    for (auto handle : expired)
+        curl_easy_cleanup(handle);
+}
+
+HttpPool::stats_t HttpPool::stats(void) const
+{
+    std::vector<uint64_t> latencies;
+    stats_t stats;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        latencies = m_latencies;
+        stats.requests = m_requests;
+        stats.reused = m_reused;
+        stats.failures = m_failures;
+        stats.waits = m_waits;
+        stats.idle = 0;
+        for (const auto &host : m_hosts)
+            stats.idle += host.second.idle.size();
+    }
+
+    stats.p50_us = stats.p99_us = 0;
+    if (!latencies.empty()) {
+        auto p50 = latencies.begin() + latencies.size() / 2;
+        std::nth_element(latencies.begin(), p50, latencies.end());
+        stats.p50_us = *p50;
+        auto p99 = latencies.begin() + latencies.size() * 99 / 100;
+        std::nth_element(latencies.begin(), p99, latencies.end());
+        stats.p99_us = *p99;
+    }
+    return stats;
+}
+
+} // CCHECKER
@@ -22,12 +22,29 @@
 #ifndef CCHECKER_APP_H
 #define CCHECKER_APP_H
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 #include <sys/types.h>
 
+#include <cert_store.h>
+
 namespace CCHECKER {
 
+/*
+ * Signature file of app's package as it was when certificates were read
+ * from it. Tells whether the package has changed since then.
+ */
+struct signature_file_t {
+    std::string path;   // empty in rows migrated from before it was kept
+    int64_t     inode;
+    int64_t     size;
+    int64_t     mtime;  // ns, 0 if it can't be trusted, see stat_signature()
+    std::string sha256; // of the whole file, empty if unknown
+
+    signature_file_t(void);
+};
+
 struct app_t {
     enum class verified_t : int {
         NO      = 0,
@@ -39,8 +56,9 @@ struct app_t {
     std::string              app_id;
     std::string              pkg_id;
     uid_t                    uid;
-    std::vector<std::string> certificates;
+    std::vector<cert_ptr>    certificates; // each followed by its issuer
     verified_t               verified;
+    signature_file_t         signature;
 
     app_t(void);
     std::string str(void) const;
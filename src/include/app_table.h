@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        app_table.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Compact, column-wise table of apps waiting for check
+ */
+#ifndef CCHECKER_APP_TABLE_H
+#define CCHECKER_APP_TABLE_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+#include <dpl/noncopyable.h>
+#include <app.h>
+#include <cert_store.h>
+
+namespace CCHECKER {
+
+/*
+ * Check buffer keeps thousands of apps. Instead of a node per app with
+ * its own strings, every field is kept in its own array (one row per
+ * app), pkg_id and app_id are interned and certificates are referred by
+ * index, so scans over the buffer touch contiguous memory only.
+ *
+ * Rows are not kept in any particular order. Not thread safe.
+ */
+class AppTable : private Noncopyable
+{
+    public:
+        struct footprint_t {
+            size_t apps;
+            size_t strings;      // distinct pkg_id and app_id
+            size_t certificates; // distinct
+            size_t bytes;        // table itself, certificates excluded
+            size_t cert_bytes;   // DER of distinct certificates
+        };
+
+        AppTable(void);
+
+        void add(const app_t &app);
+
+        // Removes app with same check_id, pkg_id, app_id and uid
+        bool remove(const app_t &app);
+
+        // Appends copies of all apps with given status
+        void select(app_t::verified_t verified, std::vector<app_t> &apps) const;
+
+        size_t size(void) const;
+        footprint_t footprint(void) const;
+
+    private:
+        typedef uint32_t index_t;
+
+        index_t intern_string(const std::string &value);
+        index_t intern_cert(const cert_ptr &cert);
+        void read_row(size_t i, app_t &app) const;
+        void erase_row(size_t i);
+        void compact(void);
+        void swap(AppTable &other);
+
+        // Columns
+        std::vector<int32_t>  m_check_id;
+        std::vector<index_t>  m_pkg_id;
+        std::vector<index_t>  m_app_id;
+        std::vector<uid_t>    m_uid;
+        std::vector<uint8_t>  m_verified;
+        std::vector<index_t>  m_certs_begin; // into m_cert_refs
+        std::vector<uint16_t> m_certs_count;
+
+        std::vector<index_t>  m_cert_refs;   // into m_certs
+        size_t                m_removed;     // rows removed since compact()
+
+        // Interned values and references of removed rows are kept until
+        // compact()
+        std::unordered_map<std::string, index_t>            m_string_index;
+        std::vector<const std::string *>                    m_strings;
+        std::unordered_map<const certificate_t *, index_t>  m_cert_index;
+        std::vector<cert_ptr>                               m_certs;
+};
+
+} // CCHECKER
+
+#endif //CCHECKER_APP_TABLE_H
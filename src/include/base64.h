@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        base64.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Base64 decoder
+ */
+#ifndef CCHECKER_BASE64_H
+#define CCHECKER_BASE64_H
+
+#include <cstddef>
+#include <string>
+
+namespace CCHECKER {
+
+/*
+ * Decodes base64 text and appends the bytes to out. Whitespace is
+ * skipped, padding is optional. Returns false on any other character
+ * outside of the alphabet or on truncated data - out is left with
+ * bytes decoded before the error then.
+ *
+ * Runs of characters without whitespace are decoded with AVX2 or SSE4.1
+ * when CPU has them, chosen at startup.
+ */
+bool base64_decode(const char *data, size_t size, std::string &out);
+
+} // CCHECKER
+
+#endif //CCHECKER_BASE64_H
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        bounded_queue.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Bounded, lock-free multi-producer/single-consumer queue
+ */
+#ifndef CCHECKER_BOUNDED_QUEUE_H
+#define CCHECKER_BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdint.h>
+
+#include <dpl/noncopyable.h>
+
+namespace CCHECKER {
+
+/*
+ * Ring buffer with a per-slot sequence number. Producers claim slots with
+ * a CAS on the enqueue position, so push() never blocks and never
+ * allocates - all slots are allocated once, in the constructor.
+ * Only one thread may call pop().
+ *
+ * Size has to be a power of two.
+ */
+template <typename T, size_t Size>
+class BoundedQueue : private Noncopyable
+{
+    static_assert(Size >= 2 && (Size & (Size - 1)) == 0,
+                  "BoundedQueue size must be a power of two");
+
+    public:
+        BoundedQueue(void) :
+            m_cells(new Cell[Size]),
+            m_enqueue_pos(0),
+            m_dequeue_pos(0),
+            m_dropped(0)
+        {
+            for (size_t i = 0; i < Size; ++i)
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        /*
+         * Returns false (and counts a drop) when the queue is full.
+         * Safe to call from many threads at once.
+         */
+        bool push(const T &value)
+        {
+            Cell *cell;
+            size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+
+            for (;;) {
+                cell = &m_cells[pos & (Size - 1)];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+                if (diff == 0) {
+                    if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                std::memory_order_relaxed))
+                        break;
+                } else if (diff < 0) {
+                    count_drop();
+                    return false;
+                } else {
+                    pos = m_enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->data = value;
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        /*
+         * Returns false when there is nothing to take.
+         * Only the consumer thread may call it.
+         */
+        bool pop(T &value)
+        {
+            size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            Cell *cell = &m_cells[pos & (Size - 1)];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+
+            if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0)
+                return false;
+
+            value = cell->data;
+            cell->sequence.store(pos + Size, std::memory_order_release);
+            m_dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        /*
+         * Records an event that was rejected before reaching push()
+         * (e.g. because it didn't fit into T).
+         */
+        void count_drop(void)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Approximate number of queued elements
+        size_t depth(void) const
+        {
+            size_t enq = m_enqueue_pos.load(std::memory_order_relaxed);
+            size_t deq = m_dequeue_pos.load(std::memory_order_relaxed);
+            return enq > deq ? enq - deq : 0;
+        }
+
+        uint64_t dropped(void) const
+        {
+            return m_dropped.load(std::memory_order_relaxed);
+        }
+
+        static size_t capacity(void)
+        {
+            return Size;
+        }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T                   data;
+        };
+
+        std::unique_ptr<Cell[]> m_cells;
+        std::atomic<size_t>     m_enqueue_pos;
+        std::atomic<size_t>     m_dequeue_pos;
+        std::atomic<uint64_t>   m_dropped;
+};
+
+} // CCHECKER
+
+#endif //CCHECKER_BOUNDED_QUEUE_H
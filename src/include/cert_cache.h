@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        cert_cache.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Cache of parsed certificates with data needed by OCSP
+ */
+#ifndef CCHECKER_CERT_CACHE_H
+#define CCHECKER_CERT_CACHE_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include <openssl/x509.h>
+
+#include <dpl/noncopyable.h>
+#include <cert_store.h>
+
+namespace CCHECKER {
+
+/*
+ * Certificate parsed once, along with everything OCSP needs from it.
+ * Hashes are the ones put into CertID when this certificate is the
+ * issuer, SHA-1 as used by OCSP_cert_to_id().
+ */
+struct parsed_cert_t {
+    std::shared_ptr<X509> x509;
+    std::string subject;    // one-line subject name
+    std::string issuer;     // one-line issuer name
+    std::string name_hash;  // of subject name
+    std::string key_hash;   // of public key
+    std::string serial;     // content octets of serial number
+    std::string serial_der; // whole DER encoded serial number
+    std::string ocsp_url;   // first OCSP url from AIA, empty if none
+};
+typedef std::shared_ptr<const parsed_cert_t> parsed_cert_ptr;
+
+/*
+ * Parsed certificates shared by all apps, keyed by SHA-256 fingerprint.
+ * When there are more than max_entries of them, ones not used outside
+ * of the cache are dropped. All methods are thread safe.
+ */
+class CertCache : private Noncopyable
+{
+    public:
+        struct stats_t {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t failures; // certificates that couldn't be parsed
+            size_t   entries;
+        };
+
+        explicit CertCache(size_t max_entries);
+
+        // Returns NULL if certificate can't be parsed
+        parsed_cert_ptr get(const certificate_t &cert);
+
+        stats_t stats(void) const;
+
+        // Parses certificate without caching, NULL on error
+        static parsed_cert_ptr parse(const std::string &der);
+
+    private:
+        typedef std::unordered_map<std::string, parsed_cert_ptr> map_t;
+
+        void evict(void);
+
+        const size_t       m_max_entries;
+        mutable std::mutex m_mutex;
+        map_t              m_entries;
+        uint64_t           m_hits;
+        uint64_t           m_misses;
+        uint64_t           m_failures;
+};
+
+} // CCHECKER
+
+#endif //CCHECKER_CERT_CACHE_H
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        cert_store.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Content-addressed store of certificates shared by apps
+ */
+#ifndef CCHECKER_CERT_STORE_H
+#define CCHECKER_CERT_STORE_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <dpl/noncopyable.h>
+
+namespace CCHECKER {
+
+// DER certificate with its SHA-256, never changed once interned
+struct certificate_t {
+    std::string der;
+    std::string sha256; // raw digest, SHA256_SIZE bytes
+};
+typedef std::shared_ptr<const certificate_t> cert_ptr;
+
+/*
+ * Apps signed by one author share intermediate and root certificates.
+ * Every distinct certificate is kept once, keyed by SHA-256 of its DER,
+ * and apps hold references to it. Entries live as long as any app
+ * references them. All methods are thread safe.
+ */
+class CertStore : private Noncopyable
+{
+    public:
+        static const size_t SHA256_SIZE = 32;
+
+        static CertStore &instance(void);
+
+        // Returns shared entry of der, creates it if there is none
+        cert_ptr intern(const std::string &der);
+
+        /*
+         * As above, for certificate which hash is already known, e.g.
+         * loaded from database. der is copied only if it isn't stored yet.
+         */
+        cert_ptr intern(const std::string &sha256, const char *der, size_t size);
+
+        // Number of distinct certificates currently referenced
+        size_t size(void);
+
+        static std::string sha256(const char *data, size_t size);
+
+    private:
+        typedef std::unordered_map<std::string, std::weak_ptr<const certificate_t>> map_t;
+
+        CertStore(void);
+
+        // Called with m_mutex locked
+        cert_ptr find(const std::string &sha256);
+        cert_ptr insert(const std::string &sha256, const char *der, size_t size);
+        void purge(void);
+
+        std::mutex m_mutex;
+        map_t      m_certs;
+        size_t     m_purge_at; // size of m_certs which triggers purge()
+};
+
+} // CCHECKER
+
+#endif //CCHECKER_CERT_STORE_H
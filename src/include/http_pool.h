@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        http_pool.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Keep-alive HTTP connections, pooled per host
+ */
+#ifndef CCHECKER_HTTP_POOL_H
+#define CCHECKER_HTTP_POOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <curl/curl.h>
+
+#include <dpl/noncopyable.h>
+
+namespace CCHECKER {
+
+/*
+ * Curl handles are kept between requests, so is the connection each of
+ * them has open - next request to the same host doesn't connect again.
+ * Handles are pooled by scheme, host and port of the url. Handle idle
+ * longer than idle_timeout is closed.
+ *
+ * At most max_per_host requests to one host run at once, others wait.
+ * All methods are thread safe; curl has to be initialized before.
+ */
+class HttpPool : private Noncopyable
+{
+    public:
+        struct stats_t {
+            uint64_t requests;
+            uint64_t reused;    // requests sent over already open connection
+            uint64_t failures;
+            uint64_t waits;     // requests that waited for per-host limit
+            size_t   idle;      // open, idle connections
+            uint64_t p50_us;    // latency of recent requests
+            uint64_t p99_us;
+        };
+
+        HttpPool(size_t max_per_host, std::chrono::seconds idle_timeout);
+        virtual ~HttpPool(void);
+
+        /*
+         * Sends body to url, response body goes to response. Returns false
+         * if the request failed or HTTP status other than 200 was returned.
+         */
+        bool post(const std::string &url,
+                  const char *content_type,
+                  const std::string &body,
+                  std::string &response);
+
+        // Closes handles idle longer than idle_timeout, post() does it as well
+        void close_idle(void);
+
+        stats_t stats(void) const;
+
+    private:
+        typedef std::chrono::steady_clock::time_point time_point_t;
+
+        struct idle_t {
+            CURL        *curl;
+            time_point_t since;
+        };
+
+        struct host_t {
+            std::vector<idle_t> idle;   // back - most recently used
+            size_t              active;
+        };
+
+        static std::string host_key(const std::string &url);
+
+        // Called with m_mutex locked, handles to be closed are put to expired
+        void expire(time_point_t now, std::vector<CURL*> &expired);
+        void add_latency(uint64_t latency_us);
+
+        static const size_t LATENCY_SAMPLES = 1024;
+
+        const size_t                    m_max_per_host;
+        const std::chrono::seconds      m_idle_timeout;
+
+        mutable std::mutex              m_mutex;
+        std::condition_variable         m_cv;
+        std::map<std::string, host_t>   m_hosts;
+        std::vector<uint64_t>           m_latencies; // ring of recent ones, us
+        size_t                          m_latency_pos;
+        uint64_t                        m_requests;
+        uint64_t                        m_reused;
+        uint64_t                        m_failures;
+        uint64_t                        m_waits;
+};
+
+} // CCHECKER
+
+#endif //CCHECKER_HTTP_POOL_H
@@ -23,12 +23,27 @@
 #ifndef CCHECKER_LOGIC_H
 #define CCHECKER_LOGIC_H
 
+#include <atomic>
+#include <chrono>
 #include <gio/gio.h>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <package_manager.h>
+#include <semaphore.h>
+#include <stdint.h>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <app.h>
+#include <app_table.h>
+#include <bounded_queue.h>
+#include <cert_cache.h>
+#include <ocsp.h>
+#include <ocsp_cache.h>
+#include <sql_query.h>
+#include <thread_pool.h>
 
 namespace CCHECKER {
 
@@ -36,12 +51,37 @@ enum error_t {
     NO_ERROR,
     REGISTER_CALLBACK_ERROR,
     DBUS_ERROR,
-    PACKAGE_MANAGER_ERROR
+    PACKAGE_MANAGER_ERROR,
+    THREAD_ERROR,
+    OCSP_ERROR,
+    DATABASE_ERROR
+};
+
+/*
+ * Event passed from package manager callback to the worker thread.
+ * Package id is copied into a fixed size buffer, so queueing an event
+ * never allocates.
+ */
+struct event_t {
+    enum class event_type_t : int {
+        INSTALL = 0
+    };
+
+    static const size_t PKG_ID_MAX_LEN = 256;
+
+    event_type_t type;
+    char         pkg_id[PKG_ID_MAX_LEN];
 };
 
 class Logic {
     public:
-        Logic(void);
+        /*
+         * ocsp_workers    - number of threads used for OCSP checks,
+         *                   0 means one thread per core.
+         * ocsp_cache_size - memory limit of OCSP response cache in bytes
+         */
+        explicit Logic(unsigned int ocsp_workers = 0,
+                       size_t ocsp_cache_size = 1024 * 1024);
         virtual ~Logic(void);
         int setup();
         static void pkg_manager_callback(
@@ -58,21 +98,100 @@ class Logic {
                 GVariant   *parameters,
                 void *logic_ptr);
 
+        // Number of events waiting for the worker thread
+        size_t event_queue_depth(void) const;
+        // Number of events lost because the queue was full
+        uint64_t event_queue_dropped(void) const;
+        // Hit/miss counters and size of OCSP response cache
+        OcspCache::stats_t ocsp_cache_stats(void) const;
+        // Hit/miss counters and size of parsed certificate cache
+        CertCache::stats_t cert_cache_stats(void) const;
+
     private:
-        //TODO: implement missing members
+        static const size_t EVENT_QUEUE_SIZE = 1024;
+        static const size_t BUFFER_PAGE_SIZE = 64;
+        // Parsed certificates, ones used by a running check are kept above it
+        static const size_t CERT_CACHE_SIZE = 1024;
+        // Database writes made within this time are committed together
+        static const unsigned int DB_GROUP_COMMIT_MS = 50;
+        typedef BoundedQueue<event_t, EVENT_QUEUE_SIZE> event_queue_t;
+
+        bool push_event(event_t::event_type_t type, const char *pkg_id);
+        void process_queue(void);
+        void process_event(const event_t &event, std::vector<app_t> &installed);
+        error_t start_worker(void);
+        void stop_worker(void);
+
+        // State of one OCSP check of the buffer, shared by pool tasks
+        struct ocsp_sweep_t;
+        typedef std::shared_ptr<ocsp_sweep_t> ocsp_sweep_ptr;
 
-        void check_ocsp(app_t &app);
+        void check_ocsp(app_t &app,
+                        const std::vector<cert_id_t> &ids,
+                        bool skipped,
+                        const ocsp_results_t &results);
+        void post_to_main_loop(GSourceFunc func, gpointer data, GDestroyNotify notify);
+        void request_ocsp_check(void);
+        static gboolean ocsp_check_callback(gpointer logic_ptr);
+        void start_ocsp_check(void);
+        void plan_ocsp_check(ocsp_sweep_ptr sweep);
+        void run_ocsp_request(ocsp_sweep_ptr sweep,
+                              const std::string &url,
+                              const Ocsp::batch_t &batch);
+        void finish_ocsp_check(ocsp_sweep_ptr sweep);
+        static gboolean ocsp_result_callback(gpointer data);
+        void process_ocsp_results(const std::vector<app_t> &apps);
+        void schedule_idle_close(void);
+        static gboolean idle_close_callback(gpointer logic_ptr);
+        void process_ocsp_result(const app_t &app);
         void add_ocsp_url(const std::string &issuer, const std::string &url);
         void pkgmanager_uninstall(const app_t &app);
-        void get_certs_from_signature(const std::string &signature, std::vector<std::string> &cert);
+
+        // State of the startup scan of installed packages, shared by pool tasks
+        struct package_scan_t;
+        typedef std::shared_ptr<package_scan_t> package_scan_ptr;
+
+        void scan_packages(void);
+        void scan_package(package_scan_ptr scan, size_t index);
+        void finish_package_scan(package_scan_ptr scan);
+        bool get_certs_from_signature(const std::string &path, std::vector<cert_ptr> &certs);
         error_t load_database_to_buffer();
+        void load_buffer_page(int32_t after_check_id);
 
         error_t register_connman_signal_handler ();
+        void read_connman_state(void);
 
-        bool m_is_online;
+        std::atomic<bool> m_is_online;
         package_manager_h m_request;
         GDBusProxy *m_proxy;
 
+        event_queue_t     m_queue;
+        sem_t             m_queue_sem;
+        std::thread       m_worker;
+        std::atomic<bool> m_should_exit;
+
+        AppTable          m_buffer;
+        std::mutex        m_mutex_buffer;
+
+        // OCSP checks are run on the pool, results are handled on m_context
+        unsigned int                m_ocsp_workers;
+        std::unique_ptr<ThreadPool> m_ocsp_pool;
+        GMainContext               *m_context;
+        OcspCache                   m_ocsp_cache;
+        CertCache                   m_cert_cache;
+
+        DB::SqlQuery                m_sqlquery;
+
+        std::chrono::steady_clock::time_point m_setup_start;
+        size_t                      m_buffer_loaded; // used by load_buffer_page only
+        int32_t                     m_buffer_load_end; // apps added later are in buffer already
+
+        // Accessed only from the main loop
+        std::map<std::string, std::string> m_ocsp_urls; // issuer -> responder
+        bool                               m_check_running;
+        bool                               m_check_requested;
+        GSource                           *m_idle_close; // closes connections after a check
+
 };
 
 } // CCHECKER
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        ocsp.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       OCSP requests - one request per responder for many certificates
+ */
+#ifndef CCHECKER_OCSP_H
+#define CCHECKER_OCSP_H
+
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cert_cache.h>
+#include <http_pool.h>
+
+namespace CCHECKER {
+
+enum class ocsp_status_t : int {
+    GOOD    = 0,
+    REVOKED = 1,
+    UNKNOWN = 2
+};
+
+// Status of single certificate taken from a responder's answer
+struct ocsp_single_t {
+    ocsp_status_t status;
+    time_t        this_update;
+    time_t        next_update; // 0 if responder didn't set it
+};
+
+// DER encoded OCSP CertID - identifies a certificate together with its issuer
+typedef std::string cert_id_t;
+typedef std::map<cert_id_t, ocsp_single_t> ocsp_results_t;
+
+class Ocsp {
+    public:
+        // Certificate (and its issuer) to be checked
+        struct cert_t {
+            cert_id_t       id;
+            std::string     key; // issuer key hash + serial, see make_cert()
+            parsed_cert_ptr cert;
+            parsed_cert_ptr issuer;
+        };
+        typedef std::vector<cert_t> batch_t;
+        // Status of certificate identified by cert_t::key
+        typedef std::vector<std::pair<std::string, ocsp_single_t>> singles_t;
+
+        // Has to be called once, before any other thread uses Ocsp
+        static bool initialize(void);
+        static void deinitialize(void);
+
+        // Connection reuse and latency of requests sent to responders
+        static HttpPool::stats_t http_stats(void);
+        // Closes connections idle for RESPONDER_IDLE_TIMEOUT
+        static void close_idle_connections(void);
+
+        // Connection to a responder is closed when it's idle longer than that
+        static const std::chrono::seconds RESPONDER_IDLE_TIMEOUT;
+
+        /*
+         * Fills cert_t for given certificate and issuer. CertID is built
+         * from hashes computed when certificates were parsed, nothing is
+         * parsed or hashed here. Key identifies certificate independently
+         * of the hash algorithm used in CertID.
+         *
+         * Returns false if issuer didn't issue cert.
+         */
+        static bool make_cert(const parsed_cert_ptr &cert,
+                              const parsed_cert_ptr &issuer,
+                              cert_t &out);
+
+        // One-line subject name of DER certificate, used as issuer key
+        static std::string subject_name(const std::string &cert);
+
+        // One-line issuer name of DER certificate, matches subject_name() of the issuer
+        static std::string issuer_name(const std::string &cert);
+
+        /*
+         * Sends single request with CertIDs of all certificates from batch
+         * to the responder. Status of every certificate from the batch is
+         * put into results, certificates the responder didn't answer for
+         * are UNKNOWN. Raw, verified response goes to response.
+         *
+         * Returns false if the request failed as a whole.
+         */
+        static bool check(const std::string &url,
+                          const batch_t &batch,
+                          ocsp_results_t &results,
+                          std::string &response);
+
+        /*
+         * Extracts statuses of all certificates from response returned
+         * earlier by check(). Signature of the response is not verified
+         * again - it has been verified before it was returned.
+         */
+        static bool parse_response(const std::string &response, singles_t &singles);
+};
+
+} // CCHECKER
+
+#endif //CCHECKER_OCSP_H
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        ocsp_cache.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       In-memory cache of OCSP responses
+ */
+#ifndef CCHECKER_OCSP_CACHE_H
+#define CCHECKER_OCSP_CACHE_H
+
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include <dpl/noncopyable.h>
+#include <ocsp.h>
+
+namespace CCHECKER {
+
+/*
+ * Keeps status of certificates, keyed by Ocsp::cert_t::key (issuer key
+ * hash + serial), until nextUpdate of the response they came from.
+ * Signed responses are kept along with the statuses; one response is
+ * shared by all certificates it covers.
+ *
+ * When the cache grows above max_bytes least recently used entries are
+ * evicted. All methods are thread safe.
+ */
+class OcspCache : private Noncopyable
+{
+    public:
+        typedef std::shared_ptr<const std::string> response_ptr;
+
+        struct stats_t {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t evictions;
+            size_t   entries;
+            size_t   bytes;
+        };
+
+        explicit OcspCache(size_t max_bytes);
+
+        /*
+         * Returns true and fills status if there is a response for key
+         * which is still valid at now. Expired entries are removed.
+         */
+        bool get(const std::string &key, time_t now, ocsp_status_t &status);
+
+        /*
+         * Stores single status taken from response. Statuses without
+         * nextUpdate or already expired are not cached.
+         * shares - number of certificates response covers, used to split
+         * response size between entries.
+         */
+        void put(const std::string &key,
+                 const ocsp_single_t &single,
+                 const response_ptr &response,
+                 size_t shares,
+                 time_t now);
+
+        stats_t stats(void) const;
+
+    private:
+        typedef std::list<std::string> lru_t;
+
+        struct entry_t {
+            ocsp_status_t   status;
+            time_t          next_update;
+            response_ptr    response;
+            size_t          bytes;
+            lru_t::iterator lru_pos;
+        };
+        typedef std::unordered_map<std::string, entry_t> map_t;
+
+        void erase(map_t::iterator it);
+        void evict(void);
+
+        const size_t       m_max_bytes;
+        mutable std::mutex m_mutex;
+        map_t              m_entries;
+        lru_t              m_lru; // front - most recently used
+        size_t             m_bytes;
+        uint64_t           m_hits;
+        uint64_t           m_misses;
+        uint64_t           m_evictions;
+};
+
+} // CCHECKER
+
+#endif //CCHECKER_OCSP_CACHE_H
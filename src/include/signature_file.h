@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        signature_file.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Change detection of package signature files
+ */
+#ifndef CCHECKER_SIGNATURE_FILE_H
+#define CCHECKER_SIGNATURE_FILE_H
+
+#include <string>
+
+#include <app.h>
+
+namespace CCHECKER {
+
+enum class signature_state_t : int {
+    UNCHANGED = 0,
+    AMBIGUOUS = 1, // metadata can't tell, content has to be compared
+    CHANGED   = 2
+};
+
+/*
+ * Fills path, inode, size and mtime of the file, sha256 is cleared.
+ * File modified just before the call could be modified again without
+ * changing its mtime, so its mtime is recorded as 0 - it will be
+ * hashed when compared next time.
+ */
+bool stat_signature(const std::string &path, signature_file_t &file);
+
+// Fills sha256 of the file content
+bool hash_signature(signature_file_t &file);
+
+// Compares metadata only, cheap enough to be run for every package
+signature_state_t compare_signature(const signature_file_t &recorded,
+                                    const signature_file_t &current);
+
+} // CCHECKER
+
+#endif //CCHECKER_SIGNATURE_FILE_H
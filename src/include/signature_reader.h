@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        signature_reader.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Streaming reader of certificates from XML signature files
+ */
+#ifndef CCHECKER_SIGNATURE_READER_H
+#define CCHECKER_SIGNATURE_READER_H
+
+#include <cstddef>
+#include <string>
+
+#include <dpl/noncopyable.h>
+
+namespace CCHECKER {
+
+/*
+ * Pulls X509Certificate elements out of signature file (e.g.
+ * signature1.xml) one by one. File is memory mapped and scanned once,
+ * without building a document - only markup is recognized, all other
+ * elements are skipped. Certificates are base64 decoded straight from
+ * the mapping, so heap used doesn't depend on size of the file.
+ */
+class SignatureReader : private Noncopyable
+{
+    public:
+        // Larger certificate makes reading fail
+        static const size_t MAX_CERT_SIZE = 64 * 1024;
+
+        explicit SignatureReader(const std::string &path);
+        virtual ~SignatureReader(void);
+
+        /*
+         * Puts DER of the next certificate into der. Returns false at the
+         * end of file or on error, failed() tells which one it was.
+         */
+        bool next(std::string &der);
+
+        bool failed(void) const;
+
+    private:
+        // Moves m_pos past the first occurrence of end, false if there is none
+        bool skip_past(const char *end);
+        bool fail(const char *reason);
+
+        std::string m_path;
+        void       *m_map;
+        size_t      m_size;
+        const char *m_pos;
+        const char *m_end;
+        bool        m_failed;
+};
+
+} // CCHECKER
+
+#endif //CCHECKER_SIGNATURE_READER_H
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        sql_query.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       This file is the implementation of SQL queries
+ */
+#ifndef CCHECKER_SQL_QUERY_H
+#define CCHECKER_SQL_QUERY_H
+
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <app.h>
+#include <cert_store.h>
+#include <dpl/db/sql_connection.h>
+#include <dpl/db/sql_connection_pool.h>
+
+namespace CCHECKER {
+namespace DB {
+
+/*
+ * cert-checker queries on top of SqlConnectionPool. Methods may be called
+ * from many threads. Writes are serialized, reads run on reader
+ * connections in parallel with them and see committed data only.
+ * connect() has to be called before any other method.
+ *
+ * Every write is done in its own transaction. In group commit mode
+ * writes made within the window share one transaction (each write in
+ * its own savepoint), committed when the window elapses or on flush().
+ * Writes reported as done may be lost on crash until then.
+ */
+class SqlQuery
+{
+    public:
+        SqlQuery(void);
+        virtual ~SqlQuery(void);
+
+        /*
+         * Opens (and creates if needed) database at path and upgrades its
+         * schema. Fails on database created by newer cert-checker.
+         */
+        bool connect(const std::string &path, size_t readers = 2);
+
+        // Zero window disables group commit, pending writes are committed
+        void set_group_commit(std::chrono::milliseconds window);
+        bool flush(void);
+
+        // Stores raw OCSP response, valid until next_update
+        bool add_ocsp_response(const std::string &response, time_t next_update);
+
+        // Removes responses expired at now and returns the rest
+        bool get_ocsp_responses(time_t now, std::vector<std::string> &responses);
+
+        // Adds app with its certificates to the check buffer, sets app.check_id
+        bool add_app_to_check(app_t &app);
+
+        /*
+         * Adds many apps in one transaction, with statements prepared once.
+         * Returns number of apps added - check_id of the ones that couldn't
+         * be added is left unchanged.
+         */
+        size_t add_apps_to_check(std::vector<app_t> &apps);
+
+        /*
+         * Like add_apps_to_check(), but first drops from apps the ones whose
+         * package is stored with the same signature already, e.g. added by
+         * an install event meanwhile.
+         */
+        size_t add_new_apps_to_check(std::vector<app_t> &apps);
+        bool remove_app_from_check(const app_t &app);
+
+        /*
+         * Appends to apps at most limit apps from the check buffer with
+         * check_id greater than after_check_id, ordered by check_id.
+         * Pass check_id of the last app to get the next page.
+         */
+        bool get_apps_to_check(int32_t after_check_id,
+                               size_t limit,
+                               std::vector<app_t> &apps);
+
+        // Highest check_id in the check buffer, 0 if it's empty
+        bool get_last_check_id(int32_t &check_id);
+
+        /*
+         * Appends check_id of every app in the check buffer with certificate
+         * issued by issuer (one-line subject name of issuer's certificate).
+         */
+        bool get_check_ids_by_issuer(const std::string &issuer,
+                                     std::vector<int32_t> &check_ids);
+
+        /*
+         * Packages added to check at least once, with their signature files
+         * as they were when last read. Apps of removed packages stay in the
+         * check buffer until they're checked.
+         */
+        bool get_packages(std::map<std::string, signature_file_t> &packages);
+        // Records signature file of package found unchanged
+        bool set_package(const std::string &pkg_id, const signature_file_t &signature);
+        bool remove_packages(const std::vector<std::string> &pkg_ids);
+
+        // OCSP responder of certificates issued by issuer
+        bool set_ocsp_url(const std::string &issuer, const std::string &url);
+        bool get_ocsp_urls(std::map<std::string, std::string> &urls);
+
+    private:
+        typedef std::unique_ptr<SqlConnection::ScopedTransaction> transaction_ptr;
+
+        bool migrate(SqlConnection &writer);
+        void move_certificates(SqlConnection &writer);
+        // Returns cert_id of stored certificate, stores it if it's new
+        int64_t insert_certificate(SqlConnection &writer, const certificate_t &cert);
+        void insert_package(SqlConnection &writer,
+                            const std::string &pkg_id,
+                            const signature_file_t &signature);
+        // Called with m_mutex locked
+        size_t insert_apps(std::vector<app_t> &apps);
+        void insert_app(SqlConnection &writer,
+                        SqlConnection::DataCommand &insert,
+                        SqlConnection::DataCommand &insert_cert,
+                        app_t &app);
+        // Called with m_mutex locked
+        void begin_group(SqlConnection &writer);
+        bool commit_group(void);
+        void run_group_commit(void);
+        void stop_group_commit(void);
+
+        std::unique_ptr<SqlConnectionPool> m_pool;
+        std::mutex                         m_mutex; // writes
+
+        std::chrono::milliseconds             m_group_window;
+        transaction_ptr                       m_group;
+        std::chrono::steady_clock::time_point m_group_deadline;
+        std::condition_variable               m_group_cond;
+        std::thread                           m_group_thread;
+        bool                                  m_group_exit;
+};
+
+} // DB
+} // CCHECKER
+
+#endif //CCHECKER_SQL_QUERY_H
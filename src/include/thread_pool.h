@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        thread_pool.h
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Fixed size pool of worker threads
+ */
+#ifndef CCHECKER_THREAD_POOL_H
+#define CCHECKER_THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include <dpl/noncopyable.h>
+
+namespace CCHECKER {
+
+class ThreadPool : private Noncopyable
+{
+    public:
+        typedef std::function<void(void)> task_t;
+
+        /*
+         * Starts given number of threads, 0 means one thread per core.
+         * Throws std::system_error if thread can't be created.
+         */
+        explicit ThreadPool(unsigned int threads = 0);
+        virtual ~ThreadPool(void);
+
+        void submit(task_t task);
+
+        size_t size(void) const;
+        size_t pending(void) const;
+
+    private:
+        void run(void);
+        void stop(void);
+
+        std::vector<std::thread> m_threads;
+        std::queue<task_t>       m_tasks;
+        mutable std::mutex       m_mutex;
+        std::condition_variable  m_cv;
+        bool                     m_stop;
+};
+
+} // CCHECKER
+
+#endif //CCHECKER_THREAD_POOL_H
@@ -20,52 +20,326 @@
  * @brief       This file is the implementation of SQL queries
  */
 
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <set>
+#include <system_error>
+#include <unistd.h>
+
 #include <logic.h>
 #include <log.h>
+#include <signature_file.h>
+#include <signature_reader.h>
 
 namespace {
 
-const char * eventTypeStr(package_manager_event_type_e type) {
-    if (type == PACKAGE_MANAGER_EVENT_TYPE_INSTALL)
-        return "PACKAGE_MANAGER_EVENT_TYPE_INSTALL";
-    if (type == PACKAGE_MANAGER_EVENT_TYPE_UNINSTALL)
-        return "PACKAGE_MANAGER_EVENT_TYPE_UNINSTALL";
-    if (type == PACKAGE_MANAGER_EVENT_TYPE_UPDATE)
-        return "PACKAGE_MANAGER_EVENT_TYPE_UPDATE";
-    return "UNKNOWN";
-}
-
-const char * eventStateStr(package_manager_event_state_e type) {
-    if (type == PACKAGE_MANAGER_EVENT_STATE_STARTED)
-        return "PACKAGE_MANAGER_EVENT_STATE_STARTED";
-    if (type == PACKAGE_MANAGER_EVENT_STATE_PROCESSING)
-        return "PACKAGE_MANAGER_EVENT_STATE_PROCESSING";
-    if (type == PACKAGE_MANAGER_EVENT_STATE_COMPLETED)
-        return "PACKAGE_MANAGER_EVENT_STATE_COMPLETED";
-    if (type == PACKAGE_MANAGER_EVENT_STATE_FAILED)
-        return "PACKAGE_MANAGER_EVENT_STATE_FAILED";
-    return "UNKNOWN";
+// Distributor's signature, its certificates are checked
+const char *const SIGNATURE_FILE = "signature1.xml";
+
+// OCSP results passed from a pool thread to the main loop
+struct ocsp_result_t {
+    CCHECKER::Logic *logic;
+    std::vector<CCHECKER::app_t> apps;
+};
+
+void free_ocsp_result(gpointer data)
+{
+    delete static_cast<ocsp_result_t*>(data);
 }
-} //anonymus
 
+// Widget keeps its signatures with the rest of its content, in res/wgt
+bool signature_path(package_info_h info, std::string &path)
+{
+    char *root = NULL;
+    char *type = NULL;
+    bool ok = package_info_get_root_path(info, &root) == PACKAGE_MANAGER_ERROR_NONE &&
+              package_info_get_type(info, &type) == PACKAGE_MANAGER_ERROR_NONE;
+    if (ok) {
+        path = root;
+        if (strcmp(type, "wgt") == 0)
+            path += "/res/wgt";
+        path += "/";
+        path += SIGNATURE_FILE;
+    }
+
+    free(root);
+    free(type);
+    return ok;
+}
+
+// Installed package as package manager sees it
+struct package_t {
+    std::string              pkg_id;
+    std::string              signature; // path, empty if unknown
+    std::vector<std::string> app_ids;
+};
+
+bool collect_app_id(package_info_app_component_type_e /*comp_type*/,
+                    const char *app_id,
+                    void *app_ids_ptr)
+{
+    if (app_id)
+        static_cast<std::vector<std::string>*>(app_ids_ptr)->push_back(app_id);
+    return true;
+}
+
+// Fills signature path and apps of the package
+bool read_package_info(package_info_h info, package_t &package)
+{
+    bool ok = signature_path(info, package.signature);
+    if (!ok) {
+        LogError("Cannot get root path of " << package.pkg_id);
+        package.signature.clear();
+    }
+
+    int ret = package_info_foreach_app_from_package(info, PACKAGE_INFO_ALLAPP,
+            collect_app_id, &package.app_ids);
+    if (ret != PACKAGE_MANAGER_ERROR_NONE) {
+        LogError("Cannot get apps of " << package.pkg_id << ": " << ret);
+        ok = false;
+    }
+    return ok;
+}
+
+bool get_package(const std::string &pkg_id, package_t &package)
+{
+    package.pkg_id = pkg_id;
+
+    package_info_h info = NULL;
+    if (package_manager_get_package_info(pkg_id.c_str(), &info) !=
+            PACKAGE_MANAGER_ERROR_NONE) {
+        LogError("Cannot get package info of " << pkg_id);
+        return false;
+    }
+
+    bool ok = read_package_info(info, package);
+    package_info_destroy(info);
+    return ok;
+}
+
+bool collect_package(package_info_h info, void *packages_ptr)
+{
+    char *pkg_id = NULL;
+    if (package_info_get_package(info, &pkg_id) != PACKAGE_MANAGER_ERROR_NONE)
+        return true;
+
+    package_t package;
+    package.pkg_id = pkg_id;
+    free(pkg_id);
+    read_package_info(info, package);
+
+    static_cast<std::vector<package_t>*>(packages_ptr)->push_back(package);
+    return true;
+}
+
+/*
+ * Appends one app per app of the package, each with certificates of the
+ * package. Package manager answers for the user cert-checker runs as, so
+ * apps are that user's. Package without apps (e.g. resources only) is
+ * checked as a whole, under its own id.
+ */
+void add_package_apps(const CCHECKER::app_t &package,
+                      const std::vector<std::string> &app_ids,
+                      std::vector<CCHECKER::app_t> &apps)
+{
+    uid_t uid = getuid();
+    if (app_ids.empty()) {
+        apps.push_back(package);
+        apps.back().app_id = package.pkg_id;
+        apps.back().uid = uid;
+        return;
+    }
+
+    for (const auto &app_id : app_ids) {
+        apps.push_back(package);
+        apps.back().app_id = app_id;
+        apps.back().uid = uid;
+    }
+}
+
+/*
+ * Counts pool task of an OCSP check or package scan as done when it goes
+ * out of scope, also when the task throws. The last one done runs finish,
+ * so a failed task can't keep the others' results from being handled.
+ */
+template <typename State>
+class TaskDone : private CCHECKER::Noncopyable
+{
+    public:
+        typedef std::shared_ptr<State> state_ptr;
+        typedef std::function<void(state_ptr)> finish_t;
+
+        TaskDone(const state_ptr &state, finish_t finish) :
+            m_state(state),
+            m_finish(finish)
+        {}
+
+        virtual ~TaskDone(void)
+        {
+            bool last;
+            {
+                std::lock_guard<std::mutex> lock(m_state->mutex);
+                last = (--m_state->pending == 0);
+            }
+            if (!last)
+                return;
+
+            try {
+                m_finish(m_state);
+            } catch (const std::exception &e) {
+                LogError("Cannot finish pool tasks: " << e.what());
+            } catch (...) {
+                LogError("Cannot finish pool tasks: unknown exception");
+            }
+        }
+
+    private:
+        state_ptr m_state;
+        finish_t  m_finish;
+};
+
+/*
+ * Submits tasks counted in state.pending. Caller has to be counted there
+ * as well, so none of the tasks can finish the state before all are
+ * submitted. Tasks that couldn't be submitted aren't counted.
+ */
+template <typename State>
+void submit_tasks(CCHECKER::ThreadPool &pool,
+                  State &state,
+                  const std::vector<CCHECKER::ThreadPool::task_t> &tasks)
+{
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.pending += tasks.size();
+    }
+
+    size_t submitted = 0;
+    try {
+        for (const auto &task : tasks) {
+            pool.submit(task);
+            ++submitted;
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.pending -= tasks.size() - submitted;
+        throw;
+    }
+}
+
+} //anonymus
 
 namespace CCHECKER {
 
+struct Logic::ocsp_sweep_t {
+    std::vector<app_t>                  apps;
+    std::vector<std::vector<cert_id_t>> ids;  // ids[i] - certificates of apps[i]
+    std::vector<bool>                   skipped; // link of apps[i] chain wasn't checked
+    std::map<std::string, std::string>  urls; // copy of m_ocsp_urls
+
+    std::mutex                          mutex;
+    size_t                              pending; // planning and requests in flight
+    ocsp_results_t                      results;
+};
+
+struct Logic::package_scan_t {
+    // Package that may have to be read
+    struct entry_t {
+        app_t                    app;      // app.signature - current state of the file
+        std::vector<std::string> app_ids;  // apps of the package, see add_package_apps()
+        bool                     known;    // recorded is taken from database
+        signature_file_t         recorded; // state of the file when it was read last time
+        signature_state_t        state;    // of metadata, CHANGED for new packages
+        bool                     read;     // certificates were read, app has to be checked
+    };
+
+    std::chrono::steady_clock::time_point start;
+    size_t                                installed; // all installed packages
+    size_t                                unchanged; // skipped by metadata
+    std::vector<entry_t>                  packages;  // new, changed or ambiguous ones
+
+    std::mutex                            mutex;
+    size_t                                pending;   // scan and packages being read
+    size_t                                same_hash; // skipped after hashing
+    size_t                                failed;
+    std::chrono::microseconds             total;     // sum of per-package times
+    std::chrono::microseconds             slowest;
+};
+
 Logic::~Logic(void)
 {
     LogDebug("Cert-checker cleaning.");
     if (m_proxy)
         g_object_unref(m_proxy);
     package_manager_destroy(m_request);
+    stop_worker();
+    sem_destroy(&m_queue_sem);
+    if (m_idle_close) {
+        g_source_destroy(m_idle_close);
+        g_source_unref(m_idle_close);
+    }
+    // Wait for running checks before the context goes away
+    m_ocsp_pool.reset();
+    if (m_context)
+        g_main_context_unref(m_context);
+    Ocsp::deinitialize();
 }
 
-Logic::Logic(void) :
+Logic::Logic(unsigned int ocsp_workers, size_t ocsp_cache_size) :
         m_is_online(false),
-        m_proxy(NULL)
-{}
+        m_proxy(NULL),
+        m_should_exit(false),
+        m_ocsp_workers(ocsp_workers),
+        m_context(NULL),
+        m_ocsp_cache(ocsp_cache_size),
+        m_cert_cache(CERT_CACHE_SIZE),
+        m_buffer_loaded(0),
+        m_buffer_load_end(0),
+        m_check_running(false),
+        m_check_requested(false),
+        m_idle_close(NULL)
+{
+    sem_init(&m_queue_sem, 0, 0);
+}
 
 int Logic::setup()
 {
+    m_setup_start = std::chrono::steady_clock::now();
+
+    if (!Ocsp::initialize()) {
+        LogError("Cannot initialize OCSP");
+        return OCSP_ERROR;
+    }
+
+    // OCSP results are delivered to the default context, the one main loop runs
+    m_context = g_main_context_ref(g_main_context_default());
+    try {
+        m_ocsp_pool.reset(new ThreadPool(m_ocsp_workers));
+    } catch (const std::system_error &e) {
+        LogError("Cannot create OCSP thread pool: " << e.what());
+        return THREAD_ERROR;
+    }
+
+    // Database is used by the worker
+    if (!m_sqlquery.connect(DB_PATH)) {
+        LogError("Cannot connect to database");
+        return DATABASE_ERROR;
+    }
+    m_sqlquery.set_group_commit(std::chrono::milliseconds(DB_GROUP_COMMIT_MS));
+
+    error_t err = load_database_to_buffer();
+    if (err != NO_ERROR)
+        return err;
+
+    // Worker has to be ready before first event arrives
+    if (start_worker() != NO_ERROR) {
+        LogError("Cannot start event queue worker");
+        return THREAD_ERROR;
+    }
+
     // Add package manager callback
     int ret = package_manager_create(&m_request);
     if (ret != PACKAGE_MANAGER_ERROR_NONE) {
@@ -89,7 +363,13 @@ int Logic::setup()
     }
     LogDebug("register connman event callback success");
 
-    return load_database_to_buffer();
+    // Packages installed from now on come as events, the scan finds
+    // the ones installed while cert-checker wasn't running
+    m_ocsp_pool->submit(std::bind(&Logic::scan_packages, this));
+
+    LogInfo("Cert-checker ready in " << std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - m_setup_start).count() << " ms");
+    return NO_ERROR;
 }
 
 error_t Logic::register_connman_signal_handler(void)
@@ -124,34 +404,193 @@ error_t Logic::register_connman_signal_handler(void)
         return REGISTER_CALLBACK_ERROR;
     }
 
+    // Connman signals changes only, state at start has to be asked for.
+    // Asked after connecting, so no change is missed.
+    read_connman_state();
+    if (m_is_online)
+        request_ocsp_check();
+
     return NO_ERROR;
 }
 
+void Logic::read_connman_state(void)
+{
+    GError *error = NULL;
+    GVariant *reply = g_dbus_proxy_call_sync(m_proxy, "GetProperties", NULL,
+            G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+    if (reply == NULL) {
+        if (error) {
+            LogError("Error getting connman properties: " << error->message);
+            g_error_free(error);
+        } else {
+            LogError("Error getting connman properties. Unknown error");
+        }
+        return;
+    }
+
+    GVariant *properties = g_variant_get_child_value(reply, 0);
+    const gchar *state = NULL;
+    if (g_variant_lookup(properties, "State", "&s", &state)) {
+        LogDebug("Connman state: " << state);
+        m_is_online = (strcmp(state, "online") == 0);
+    }
+
+    g_variant_unref(properties);
+    g_variant_unref(reply);
+}
+
 void Logic::pkg_manager_callback(
-        const char *type,
+        const char */*type*/,
         const char *package,
         package_manager_event_type_e eventType,
         package_manager_event_state_e eventState,
-        int progress,
+        int /*progress*/,
         package_manager_error_e error,
         void *logic_ptr)
 {
-    LogDebug("---- packageInstalledEventCallback ----\n");
-    LogDebug("Type: " << type << ", package: " << package << ", Event type: " <<
-            eventTypeStr(eventType) << ", Event state: " << eventStateStr(eventState) <<
-            ", progress: " << progress <<", error: " << error);
+    // This is called on package manager's dispatcher, so only filter the
+    // event and pass it to the worker thread. No allocations nor logs here.
+    if (eventType != PACKAGE_MANAGER_EVENT_TYPE_INSTALL ||
+        eventState != PACKAGE_MANAGER_EVENT_STATE_COMPLETED ||
+        error != PACKAGE_MANAGER_ERROR_NONE ||
+        package == NULL)
+        return;
+
     Logic *logic = static_cast<Logic*>(logic_ptr);
+    logic->push_event(event_t::event_type_t::INSTALL, package);
+}
+
+bool Logic::push_event(event_t::event_type_t type, const char *pkg_id)
+{
+    size_t len = strnlen(pkg_id, event_t::PKG_ID_MAX_LEN);
+    if (len == event_t::PKG_ID_MAX_LEN) {
+        m_queue.count_drop();
+        return false;
+    }
+
+    event_t event;
+    event.type = type;
+    memcpy(event.pkg_id, pkg_id, len + 1);
+
+    if (!m_queue.push(event))
+        return false;
+
+    sem_post(&m_queue_sem);
+    return true;
+}
+
+size_t Logic::event_queue_depth(void) const
+{
+    return m_queue.depth();
+}
+
+uint64_t Logic::event_queue_dropped(void) const
+{
+    return m_queue.dropped();
+}
+
+OcspCache::stats_t Logic::ocsp_cache_stats(void) const
+{
+    return m_ocsp_cache.stats();
+}
+
+CertCache::stats_t Logic::cert_cache_stats(void) const
+{
+    return m_cert_cache.stats();
+}
 
-    if (eventType != PACKAGE_MANAGER_EVENT_TYPE_INSTALL||
-    eventState != PACKAGE_MANAGER_EVENT_STATE_COMPLETED ||
-    error != PACKAGE_MANAGER_ERROR_NONE ||
-    package == NULL) {
-        LogDebug("PackageInstalled Callback error or Invalid Param");
-    } else {
-        LogDebug("PackageInstalled Callback. Instalation of: " << package <<
-                ", error: " << error << ", progress: " << progress);
-        // TODO: Add event to queue here
-        (void) logic;
+error_t Logic::start_worker(void)
+{
+    try {
+        m_worker = std::thread(&Logic::process_queue, this);
+    } catch (const std::system_error &e) {
+        LogError("Cannot create worker thread: " << e.what());
+        return THREAD_ERROR;
+    }
+    return NO_ERROR;
+}
+
+void Logic::stop_worker(void)
+{
+    if (!m_worker.joinable())
+        return;
+
+    m_should_exit = true;
+    sem_post(&m_queue_sem);
+    m_worker.join();
+
+    LogDebug("Event queue worker stopped. Events left: " << m_queue.depth() <<
+            ", dropped: " << m_queue.dropped());
+}
+
+void Logic::process_queue(void)
+{
+    LogDebug("Event queue worker started");
+
+    for (;;) {
+        if (sem_wait(&m_queue_sem) != 0) {
+            if (errno == EINTR)
+                continue;
+            LogError("sem_wait error: " << errno);
+            return;
+        }
+
+        if (m_should_exit)
+            return;
+
+        // Producers post after their slot is published, so drain everything
+        // that is ready - a slot that isn't ready yet will be posted later.
+        event_t event;
+        bool drained = false;
+        std::vector<app_t> installed;
+        while (m_queue.pop(event)) {
+            process_event(event, installed);
+            drained = true;
+        }
+
+        if (!installed.empty()) {
+            // Kept in the buffer even if they couldn't be stored
+            m_sqlquery.add_apps_to_check(installed);
+
+            std::lock_guard<std::mutex> lock(m_mutex_buffer);
+            for (const auto &app : installed)
+                m_buffer.add(app);
+        }
+
+        // Whole burst goes to one OCSP check
+        if (drained)
+            request_ocsp_check();
+
+        LogDebug("Event queue drained. Depth: " << m_queue.depth() <<
+                ", dropped: " << m_queue.dropped());
+    }
+}
+
+// Installed apps are stored in bulk, after the whole queue is drained
+void Logic::process_event(const event_t &event, std::vector<app_t> &installed)
+{
+    switch (event.type) {
+    case event_t::event_type_t::INSTALL: {
+        LogDebug("Installation of: " << event.pkg_id);
+
+        package_t package;
+        app_t app;
+        app.pkg_id = event.pkg_id;
+        // Package not stored is found by the scan at next start
+        if (!get_package(app.pkg_id, package) ||
+            !stat_signature(package.signature, app.signature) ||
+            !hash_signature(app.signature) ||
+            !get_certs_from_signature(package.signature, app.certificates)) {
+            LogError("Cannot read certificates of " << app.pkg_id <<
+                    ", left for the next scan");
+            break;
+        }
+        add_package_apps(app, package.app_ids, installed);
+        break;
+    }
+    default:
+        LogError("Unknown event type: " << static_cast<int>(event.type));
+        break;
     }
 }
 
@@ -176,6 +615,7 @@ void Logic::connman_callback(GDBusProxy */*proxy*/,
     if (params_str == "('State', <'online'>)") {
         LogDebug("Device online");
         logic->m_is_online = true;
+        logic->start_ocsp_check();
     }
     else if (params_str == "('State', <'offline'>)") {
         LogDebug("Device offline");
@@ -183,15 +623,293 @@ void Logic::connman_callback(GDBusProxy */*proxy*/,
     }
 }
 
-void Logic::check_ocsp(app_t &app)
+// App is verified only when every link of its chain is GOOD
+void Logic::check_ocsp(app_t &app,
+                       const std::vector<cert_id_t> &ids,
+                       bool skipped,
+                       const ocsp_results_t &results)
 {
-    (void)app;
+    bool good = !skipped && !ids.empty();
+    app.verified = app_t::verified_t::UNKNOWN;
+
+    for (const auto &id : ids) {
+        auto it = results.find(id);
+        if (it == results.end() || it->second.status == ocsp_status_t::UNKNOWN) {
+            good = false;
+        } else if (it->second.status == ocsp_status_t::REVOKED) {
+            app.verified = app_t::verified_t::NO;
+            return;
+        }
+    }
+
+    if (good)
+        app.verified = app_t::verified_t::YES;
 }
 
+void Logic::post_to_main_loop(GSourceFunc func, gpointer data, GDestroyNotify notify)
+{
+    GSource *source = g_idle_source_new();
+    g_source_set_callback(source, func, data, notify);
+    g_source_attach(source, m_context);
+    g_source_unref(source);
+}
+
+void Logic::request_ocsp_check(void)
+{
+    post_to_main_loop(Logic::ocsp_check_callback, this, NULL);
+}
+
+gboolean Logic::ocsp_check_callback(gpointer logic_ptr)
+{
+    static_cast<Logic*>(logic_ptr)->start_ocsp_check();
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Checking goes in three steps: start_ocsp_check() takes a snapshot of the
+ * buffer on the main loop, plan_ocsp_check() groups certificates of all
+ * apps by responder on the pool and run_ocsp_request() sends one request
+ * per responder. The last finished request evaluates apps and passes them
+ * back to the main loop. Requests for a check made while one is running
+ * are merged into a single check started after it.
+ */
+void Logic::start_ocsp_check(void)
+{
+    if (!m_is_online)
+        return;
+
+    if (m_check_running) {
+        m_check_requested = true;
+        return;
+    }
+
+    ocsp_sweep_ptr sweep = std::make_shared<ocsp_sweep_t>();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex_buffer);
+        m_buffer.select(app_t::verified_t::UNKNOWN, sweep->apps);
+    }
+
+    if (sweep->apps.empty())
+        return;
+
+    sweep->urls = m_ocsp_urls;
+    sweep->pending = 1; // plan_ocsp_check()
+    m_check_running = true;
+
+    LogDebug("Starting OCSP check of " << sweep->apps.size() << " apps");
+    m_ocsp_pool->submit(std::bind(&Logic::plan_ocsp_check, this, sweep));
+}
+
+void Logic::plan_ocsp_check(ocsp_sweep_ptr sweep)
+{
+    TaskDone<ocsp_sweep_t> done(sweep,
+            std::bind(&Logic::finish_ocsp_check, this, std::placeholders::_1));
+
+    // (responder, issuer key hash) -> certificates. A response is verified
+    // against a single issuer, so one request must not mix CAs
+    std::map<std::pair<std::string, std::string>, Ocsp::batch_t> batches;
+    std::set<cert_id_t> queued;
+    time_t now = time(NULL);
+
+    sweep->ids.resize(sweep->apps.size());
+    // Set until chain of the app is planned as a whole
+    sweep->skipped.resize(sweep->apps.size(), true);
+    for (size_t i = 0; i < sweep->apps.size(); ++i) {
+        const auto &certs = sweep->apps[i].certificates;
+        bool skipped = false;
+
+        // Each certificate is parsed once, by whichever app uses it first
+        parsed_cert_ptr issuer = certs.empty() ? parsed_cert_ptr() :
+                                 m_cert_cache.get(*certs[0]);
+        for (size_t j = 0; j + 1 < certs.size(); ++j) {
+            parsed_cert_ptr parsed = issuer;
+            issuer = m_cert_cache.get(*certs[j + 1]);
+
+            Ocsp::cert_t cert;
+            // Next certificate is not the issuer or can't be parsed
+            if (!parsed || !issuer || !Ocsp::make_cert(parsed, issuer, cert)) {
+                skipped = true;
+                continue;
+            }
+
+            // No requests are running yet, results can be used without lock
+            ocsp_status_t status;
+            if (m_ocsp_cache.get(cert.key, now, status)) {
+                sweep->ids[i].push_back(cert.id);
+                sweep->results[cert.id] = ocsp_single_t{status, 0, 0};
+                continue;
+            }
+
+            std::string url = parsed->ocsp_url;
+            if (url.empty()) {
+                auto it = sweep->urls.find(issuer->subject);
+                if (it == sweep->urls.end()) {
+                    LogDebug("No OCSP responder for certificate of " <<
+                            sweep->apps[i].pkg_id);
+                    skipped = true;
+                    continue;
+                }
+                url = it->second;
+            }
+
+            sweep->ids[i].push_back(cert.id);
+            // Apps sharing an issuer share the CertID as well
+            if (queued.insert(cert.id).second)
+                batches[std::make_pair(url, issuer->key_hash)].push_back(cert);
+        }
+        sweep->skipped[i] = skipped;
+    }
+
+    if (batches.empty())
+        return;
+
+    LogDebug("Sending " << queued.size() << " CertIDs in " << batches.size() <<
+            " OCSP requests");
+
+    std::vector<ThreadPool::task_t> tasks;
+    for (const auto &batch : batches)
+        tasks.push_back(std::bind(&Logic::run_ocsp_request,
+                this, sweep, batch.first.first, batch.second));
+    submit_tasks(*m_ocsp_pool, *sweep, tasks);
+}
+
+void Logic::run_ocsp_request(ocsp_sweep_ptr sweep,
+                             const std::string &url,
+                             const Ocsp::batch_t &batch)
+{
+    TaskDone<ocsp_sweep_t> done(sweep,
+            std::bind(&Logic::finish_ocsp_check, this, std::placeholders::_1));
+
+    ocsp_results_t results;
+    std::string response;
+    // On failure all certificates from the batch stay UNKNOWN
+    if (Ocsp::check(url, batch, results, response)) {
+        // Response is stored until the first of its statuses expires
+        time_t now = time(NULL);
+        time_t next_update = 0;
+        for (const auto &result : results) {
+            const ocsp_single_t &single = result.second;
+            if (single.status != ocsp_status_t::UNKNOWN && single.next_update > now &&
+                (next_update == 0 || single.next_update < next_update))
+                next_update = single.next_update;
+        }
+        if (next_update != 0)
+            m_sqlquery.add_ocsp_response(response, next_update);
+
+        OcspCache::response_ptr shared =
+            std::make_shared<const std::string>(std::move(response));
+        for (const auto &cert : batch)
+            m_ocsp_cache.put(cert.key, results[cert.id], shared, batch.size(), now);
+    }
+
+    std::lock_guard<std::mutex> lock(sweep->mutex);
+    sweep->results.insert(results.begin(), results.end());
+}
+
+void Logic::finish_ocsp_check(ocsp_sweep_ptr sweep)
+{
+    // Planning may have stopped halfway, apps it didn't reach stay UNKNOWN
+    sweep->ids.resize(sweep->apps.size());
+    sweep->skipped.resize(sweep->apps.size(), true);
+    for (size_t i = 0; i < sweep->apps.size(); ++i)
+        check_ocsp(sweep->apps[i], sweep->ids[i], sweep->skipped[i], sweep->results);
+
+    OcspCache::stats_t stats = m_ocsp_cache.stats();
+    LogDebug("OCSP cache hits: " << stats.hits << ", misses: " << stats.misses <<
+            ", evictions: " << stats.evictions << ", entries: " << stats.entries <<
+            ", bytes: " << stats.bytes);
+
+    HttpPool::stats_t http = Ocsp::http_stats();
+    LogDebug("OCSP requests: " << http.requests << ", reused connections: " << http.reused <<
+            ", failed: " << http.failures << ", waited: " << http.waits << ", idle: " <<
+            http.idle << ", latency p50: " << http.p50_us << " us, p99: " << http.p99_us << " us");
+
+    post_to_main_loop(Logic::ocsp_result_callback,
+            new ocsp_result_t{this, std::move(sweep->apps)},
+            free_ocsp_result);
+}
+
+gboolean Logic::ocsp_result_callback(gpointer data)
+{
+    ocsp_result_t *result = static_cast<ocsp_result_t*>(data);
+    result->logic->process_ocsp_results(result->apps);
+    return G_SOURCE_REMOVE;
+}
+
+void Logic::process_ocsp_results(const std::vector<app_t> &apps)
+{
+    for (const auto &app : apps)
+        process_ocsp_result(app);
+
+    m_check_running = false;
+    if (m_check_requested) {
+        m_check_requested = false;
+        start_ocsp_check();
+    }
+    schedule_idle_close();
+}
+
+/*
+ * Requests are sent only by checks, so connections they left open would
+ * wait for the next check to be closed. Timer is restarted by each check;
+ * when it fires, every connection has been idle for the whole timeout.
+ */
+void Logic::schedule_idle_close(void)
+{
+    if (m_idle_close) {
+        g_source_destroy(m_idle_close);
+        g_source_unref(m_idle_close);
+    }
+    // Second timers are coalesced and may fire up to a second early
+    m_idle_close = g_timeout_source_new_seconds(
+            static_cast<guint>(Ocsp::RESPONDER_IDLE_TIMEOUT.count() + 1));
+    g_source_set_callback(m_idle_close, Logic::idle_close_callback, this, NULL);
+    g_source_attach(m_idle_close, m_context);
+}
+
+gboolean Logic::idle_close_callback(gpointer logic_ptr)
+{
+    Logic *logic = static_cast<Logic*>(logic_ptr);
+    g_source_unref(logic->m_idle_close);
+    logic->m_idle_close = NULL;
+    // Closing may talk to the servers, keep it off the main loop
+    logic->m_ocsp_pool->submit(&Ocsp::close_idle_connections);
+    return G_SOURCE_REMOVE;
+}
+
+void Logic::process_ocsp_result(const app_t &app)
+{
+    LogDebug("OCSP result for " << app.str() << ": " << static_cast<int>(app.verified));
+
+    if (app.verified == app_t::verified_t::UNKNOWN)
+        return; // Stays in the buffer, will be checked again
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex_buffer);
+        m_buffer.remove(app);
+    }
+    m_sqlquery.remove_app_from_check(app);
+
+    if (app.verified == app_t::verified_t::NO)
+        pkgmanager_uninstall(app);
+}
+
+// issuer is the one-line subject name of issuer's certificate
 void Logic::add_ocsp_url(const std::string &issuer, const std::string &url)
 {
-    (void)issuer;
-    (void)url;
+    m_ocsp_urls[issuer] = url;
+    m_sqlquery.set_ocsp_url(issuer, url);
+
+    // Apps that couldn't be checked without the responder stayed UNKNOWN,
+    // they may be checked now
+    std::vector<int32_t> check_ids;
+    if (!m_sqlquery.get_check_ids_by_issuer(issuer, check_ids))
+        return;
+
+    LogInfo("OCSP responder " << url << " added for " << issuer << ", apps to check again: " <<
+            check_ids.size());
+    if (!check_ids.empty())
+        request_ocsp_check();
 }
 
 void Logic::pkgmanager_uninstall(const app_t &app)
@@ -199,15 +917,259 @@ void Logic::pkgmanager_uninstall(const app_t &app)
     (void)app;
 }
 
-void Logic::get_certs_from_signature(const std::string &signature, std::vector<std::string> &cert)
+/*
+ * Packages are compared with the ones stored in database. Signature files
+ * of known packages are stat-ed here, only new packages and ones whose
+ * files have changed are handled on the pool, one task per package. The
+ * last finished task adds all of them to check at once.
+ */
+void Logic::scan_packages(void)
+{
+    package_scan_ptr scan = std::make_shared<package_scan_t>();
+    scan->start = std::chrono::steady_clock::now();
+    scan->installed = 0;
+    scan->unchanged = 0;
+    scan->same_hash = 0;
+    scan->failed = 0;
+    scan->total = scan->slowest = std::chrono::microseconds::zero();
+
+    std::map<std::string, signature_file_t> known;
+    if (!m_sqlquery.get_packages(known)) {
+        LogError("Cannot scan installed packages");
+        return;
+    }
+
+    std::vector<package_t> packages;
+    int ret = package_manager_foreach_package_info(collect_package, &packages);
+    if (ret != PACKAGE_MANAGER_ERROR_NONE) {
+        LogError("package_manager_foreach_package_info error: " << ret);
+        return;
+    }
+    scan->installed = packages.size();
+
+    scan->pending = 1; // this task
+    TaskDone<package_scan_t> done(scan,
+            std::bind(&Logic::finish_package_scan, this, std::placeholders::_1));
+
+    for (const auto &package : packages) {
+        package_scan_t::entry_t entry;
+        entry.app.pkg_id = package.pkg_id;
+        entry.app_ids = package.app_ids;
+        entry.known = false;
+        entry.state = signature_state_t::CHANGED;
+        entry.read = false;
+
+        bool stated = !package.signature.empty() &&
+                      stat_signature(package.signature, entry.app.signature);
+
+        auto it = known.find(package.pkg_id);
+        if (it != known.end()) {
+            entry.known = true;
+            entry.recorded = it->second;
+            known.erase(it);
+
+            // Can't tell anything without the file, it's checked next time
+            if (!stated) {
+                ++scan->failed;
+                continue;
+            }
+
+            entry.state = compare_signature(entry.recorded, entry.app.signature);
+            if (entry.state == signature_state_t::UNCHANGED) {
+                ++scan->unchanged;
+                continue;
+            }
+        }
+
+        scan->packages.push_back(entry);
+    }
+
+    // Whatever is left has been uninstalled
+    if (!known.empty()) {
+        std::vector<std::string> removed;
+        for (const auto &package : known)
+            removed.push_back(package.first);
+        m_sqlquery.remove_packages(removed);
+    }
+
+    std::vector<ThreadPool::task_t> tasks;
+    for (size_t i = 0; i < scan->packages.size(); ++i)
+        tasks.push_back(std::bind(&Logic::scan_package, this, scan, i));
+    submit_tasks(*m_ocsp_pool, *scan, tasks);
+}
+
+void Logic::scan_package(package_scan_ptr scan, size_t index)
+{
+    TaskDone<package_scan_t> done(scan,
+            std::bind(&Logic::finish_package_scan, this, std::placeholders::_1));
+
+    // Each task owns its own entry, packages aren't resized until all are done
+    package_scan_t::entry_t &entry = scan->packages[index];
+    app_t &app = entry.app;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    bool ok = hash_signature(app.signature);
+    bool same = false;
+    if (ok && entry.state == signature_state_t::AMBIGUOUS) {
+        // Package known from before signature files were kept is taken as it was
+        same = entry.recorded.path.empty() ||
+               entry.recorded.sha256 == app.signature.sha256;
+        if (same)
+            m_sqlquery.set_package(app.pkg_id, app.signature);
+    }
+
+    // Package whose certificates can't be read is tried again next time
+    if (ok && !same) {
+        ok = get_certs_from_signature(app.signature.path, app.certificates);
+        entry.read = ok;
+    }
+    if (!ok)
+        LogError("Cannot read certificates of " << app.pkg_id << ", left for the next scan");
+
+    std::chrono::microseconds time = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    LogDebug("Signature of " << app.pkg_id << " handled in " << time.count() <<
+            " us, read: " << entry.read << ", certificates: " << app.certificates.size());
+
+    std::lock_guard<std::mutex> lock(scan->mutex);
+    scan->total += time;
+    if (time > scan->slowest)
+        scan->slowest = time;
+    if (same)
+        ++scan->same_hash;
+    if (!ok)
+        ++scan->failed;
+}
+
+void Logic::finish_package_scan(package_scan_ptr scan)
 {
-    (void)signature;
-    (void)cert;
+    std::vector<app_t> apps;
+    size_t read = 0;
+    size_t changed = 0;
+    for (const auto &entry : scan->packages) {
+        if (!entry.read)
+            continue;
+        ++read;
+        if (entry.known)
+            ++changed;
+        add_package_apps(entry.app, entry.app_ids, apps);
+    }
+
+    if (!apps.empty()) {
+        // Package installed during the scan may have come as an event too,
+        // apps already stored are dropped. Kept in the buffer even if they
+        // couldn't be stored.
+        m_sqlquery.add_new_apps_to_check(apps);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex_buffer);
+            for (const auto &app : apps)
+                m_buffer.add(app);
+        }
+        request_ocsp_check();
+    }
+
+    LogInfo("Scanned " << scan->installed << " installed packages in " <<
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - scan->start).count() << " ms, unchanged: " <<
+            scan->unchanged << " (+" << scan->same_hash << " by hash), new: " <<
+            read - changed << ", changed: " << changed << ", failed: " << scan->failed <<
+            ", threads: " << m_ocsp_pool->size());
+    if (!scan->packages.empty())
+        LogInfo("Signature time per package avg: " <<
+                scan->total.count() / static_cast<int64_t>(scan->packages.size()) <<
+                " us, max: " << scan->slowest.count() << " us");
+}
+
+/*
+ * Certificates in order of the file - each followed by its issuer.
+ * Returns false unless the whole file has been read and there was
+ * something to check in it.
+ */
+bool Logic::get_certs_from_signature(const std::string &path, std::vector<cert_ptr> &certs)
+{
+    SignatureReader reader(path);
+    std::string der;
+    while (reader.next(der))
+        certs.push_back(CertStore::instance().intern(der));
+    return !reader.failed() && !certs.empty();
 }
 
 error_t Logic::load_database_to_buffer()
 {
+    // OCSP responses still valid after restart go back to the cache
+    time_t now = time(NULL);
+    std::vector<std::string> responses;
+    if (!m_sqlquery.get_ocsp_responses(now, responses))
+        return DATABASE_ERROR;
+
+    for (const auto &response : responses) {
+        Ocsp::singles_t singles;
+        if (!Ocsp::parse_response(response, singles))
+            continue;
+
+        OcspCache::response_ptr shared = std::make_shared<const std::string>(response);
+        for (const auto &single : singles)
+            m_ocsp_cache.put(single.first, single.second, shared, singles.size(), now);
+    }
+    LogDebug("Loaded " << responses.size() << " OCSP responses from database");
+
+    if (!m_sqlquery.get_ocsp_urls(m_ocsp_urls))
+        return DATABASE_ERROR;
+
+    // Apps waiting for check may be many, they're loaded page by page on
+    // the pool while the main loop already runs
+    m_buffer_loaded = 0;
+    if (!m_sqlquery.get_last_check_id(m_buffer_load_end))
+        return DATABASE_ERROR;
+    m_ocsp_pool->submit(std::bind(&Logic::load_buffer_page, this, 0));
+
     return error_t::NO_ERROR;
 }
 
+void Logic::load_buffer_page(int32_t after_check_id)
+{
+    std::vector<app_t> apps;
+    if (!m_sqlquery.get_apps_to_check(after_check_id, BUFFER_PAGE_SIZE, apps)) {
+        LogError("Loading of check buffer stopped after " << m_buffer_loaded << " apps");
+        return;
+    }
+
+    // Worker adds new apps to the buffer by itself
+    bool last_page = apps.size() < BUFFER_PAGE_SIZE;
+    while (!apps.empty() && apps.back().check_id > m_buffer_load_end) {
+        apps.pop_back();
+        last_page = true;
+    }
+
+    if (!apps.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex_buffer);
+            for (const auto &app : apps)
+                m_buffer.add(app);
+        }
+        m_buffer_loaded += apps.size();
+        request_ocsp_check();
+    }
+
+    if (last_page) {
+        LogInfo("Check buffer of " << m_buffer_loaded << " apps loaded in " <<
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - m_setup_start).count() << " ms");
+
+        AppTable::footprint_t footprint;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex_buffer);
+            footprint = m_buffer.footprint();
+        }
+        LogInfo("Check buffer uses " << footprint.bytes << " bytes for " <<
+                footprint.apps << " apps with " << footprint.strings << " ids and " <<
+                footprint.certificates << " certificates (" << footprint.cert_bytes <<
+                " bytes of DER)");
+        return;
+    }
+
+    m_ocsp_pool->submit(std::bind(&Logic::load_buffer_page, this, apps.back().check_id));
+}
+
 } //CCHECKER
@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        ocsp.cpp
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       OCSP requests - one request per responder for many certificates
+ */
+#include <chrono>
+#include <memory>
+
+#include <curl/curl.h>
+#include <openssl/err.h>
+#include <openssl/ocsp.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <http_pool.h>
+#include <log.h>
+#include <ocsp.h>
+
+namespace {
+
+typedef std::unique_ptr<OCSP_REQUEST, decltype(&OCSP_REQUEST_free)> RequestPtr;
+typedef std::unique_ptr<OCSP_RESPONSE, decltype(&OCSP_RESPONSE_free)> ResponsePtr;
+typedef std::unique_ptr<OCSP_BASICRESP, decltype(&OCSP_BASICRESP_free)> BasicRespPtr;
+typedef std::unique_ptr<X509_STORE, decltype(&X509_STORE_free)> StorePtr;
+typedef std::unique_ptr<STACK_OF(X509), void(*)(STACK_OF(X509)*)> X509StackPtr;
+
+// Responder gets at most this many requests at once
+const size_t MAX_REQUESTS_PER_RESPONDER = 4;
+// Accepted clock difference between device and responder
+const long MAX_CLOCK_SKEW_SEC = 300;
+
+// AlgorithmIdentifier of SHA-1 with NULL parameters
+const char SHA1_ALGORITHM[] = "\x30\x09\x06\x05\x2b\x0e\x03\x02\x1a\x05\x00";
+
+// Appends DER element with given tag and content
+void append_der(std::string &out, int tag, const std::string &content)
+{
+    out.push_back(static_cast<char>(tag));
+
+    size_t len = content.size();
+    if (len < 0x80) {
+        out.push_back(static_cast<char>(len));
+    } else {
+        std::string bytes;
+        for (; len > 0; len >>= 8)
+            bytes.insert(bytes.begin(), static_cast<char>(len & 0xff));
+        out.push_back(static_cast<char>(0x80 | bytes.size()));
+        out.append(bytes);
+    }
+
+    out.append(content);
+}
+
+// Returns 0 for NULL time
+time_t to_time_t(const ASN1_GENERALIZEDTIME *time)
+{
+    int days, secs;
+    if (!time || !ASN1_TIME_diff(&days, &secs, NULL, time))
+        return 0;
+    return ::time(NULL) + static_cast<time_t>(days) * 24 * 60 * 60 + secs;
+}
+
+// Issuer key hash + serial number
+std::string make_key(OCSP_CERTID *id)
+{
+    ASN1_OCTET_STRING *key_hash = NULL;
+    ASN1_INTEGER *serial = NULL;
+    if (!OCSP_id_get0_info(NULL, NULL, &key_hash, &serial, id))
+        return std::string();
+
+    std::string key(reinterpret_cast<const char*>(ASN1_STRING_get0_data(key_hash)),
+            ASN1_STRING_length(key_hash));
+    key.append(reinterpret_cast<const char*>(ASN1_STRING_get0_data(serial)),
+            ASN1_STRING_length(serial));
+    return key;
+}
+
+void free_x509_stack(STACK_OF(X509) *stack)
+{
+    sk_X509_pop_free(stack, X509_free);
+}
+
+// Created by Ocsp::initialize(), responders are asked over it
+std::unique_ptr<CCHECKER::HttpPool> http_pool;
+
+} //anonymus
+
+namespace CCHECKER {
+
+bool Ocsp::initialize(void)
+{
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        LogError("curl_global_init failed");
+        return false;
+    }
+    http_pool.reset(new HttpPool(MAX_REQUESTS_PER_RESPONDER, RESPONDER_IDLE_TIMEOUT));
+    return true;
+}
+
+void Ocsp::deinitialize(void)
+{
+    http_pool.reset();
+    curl_global_cleanup();
+}
+
+const std::chrono::seconds Ocsp::RESPONDER_IDLE_TIMEOUT(60);
+
+HttpPool::stats_t Ocsp::http_stats(void)
+{
+    return http_pool->stats();
+}
+
+void Ocsp::close_idle_connections(void)
+{
+    http_pool->close_idle();
+}
+
+bool Ocsp::make_cert(const parsed_cert_ptr &cert,
+                     const parsed_cert_ptr &issuer,
+                     cert_t &out)
+{
+    if (X509_check_issued(issuer->x509.get(), cert->x509.get()) != X509_V_OK)
+        return false;
+
+    // Same encoding as i2d_OCSP_CERTID(OCSP_cert_to_id(NULL, cert, issuer))
+    std::string content(SHA1_ALGORITHM, sizeof(SHA1_ALGORITHM) - 1);
+    append_der(content, V_ASN1_OCTET_STRING, issuer->name_hash);
+    append_der(content, V_ASN1_OCTET_STRING, issuer->key_hash);
+    content.append(cert->serial_der);
+
+    out.id.clear();
+    append_der(out.id, V_ASN1_SEQUENCE | V_ASN1_CONSTRUCTED, content);
+
+    out.key = issuer->key_hash + cert->serial;
+    out.cert = cert;
+    out.issuer = issuer;
+    return true;
+}
+
+std::string Ocsp::subject_name(const std::string &cert)
+{
+    parsed_cert_ptr parsed = CertCache::parse(cert);
+    return parsed ? parsed->subject : std::string();
+}
+
+std::string Ocsp::issuer_name(const std::string &cert)
+{
+    parsed_cert_ptr parsed = CertCache::parse(cert);
+    return parsed ? parsed->issuer : std::string();
+}
+
+bool Ocsp::check(const std::string &url,
+                 const batch_t &batch,
+                 ocsp_results_t &results,
+                 std::string &response)
+{
+    for (const auto &cert : batch)
+        results[cert.id] = ocsp_single_t{ocsp_status_t::UNKNOWN, 0, 0};
+
+    RequestPtr request(OCSP_REQUEST_new(), OCSP_REQUEST_free);
+    X509StackPtr issuers(sk_X509_new_null(), free_x509_stack);
+    std::vector<OCSP_CERTID*> ids; // owned by request
+    if (!request || !issuers)
+        return false;
+
+    for (const auto &cert : batch) {
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(cert.id.data());
+        OCSP_CERTID *id = d2i_OCSP_CERTID(NULL, &p, cert.id.size());
+        if (!id || !OCSP_request_add0_id(request.get(), id)) {
+            OCSP_CERTID_free(id);
+            LogError("Cannot add CertID to OCSP request");
+            return false;
+        }
+        ids.push_back(id);
+
+        X509 *issuer = cert.issuer->x509.get();
+        if (X509_up_ref(issuer) && !sk_X509_push(issuers.get(), issuer))
+            X509_free(issuer);
+    }
+
+    unsigned char *der = NULL;
+    int len = i2d_OCSP_REQUEST(request.get(), &der);
+    if (len <= 0) {
+        LogError("Cannot encode OCSP request");
+        return false;
+    }
+    std::string request_der(reinterpret_cast<char*>(der), len);
+    OPENSSL_free(der);
+
+    LogDebug("Sending OCSP request with " << batch.size() << " certificates to " << url);
+
+    std::string response_der;
+    if (!http_pool->post(url, "application/ocsp-request", request_der, response_der))
+        return false;
+
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(response_der.data());
+    ResponsePtr parsed(d2i_OCSP_RESPONSE(NULL, &p, response_der.size()),
+            OCSP_RESPONSE_free);
+    if (!parsed) {
+        LogError("Cannot parse OCSP response from " << url);
+        return false;
+    }
+
+    int status = OCSP_response_status(parsed.get());
+    if (status != OCSP_RESPONSE_STATUS_SUCCESSFUL) {
+        LogError("OCSP responder " << url << " error: " <<
+                OCSP_response_status_str(status));
+        return false;
+    }
+
+    BasicRespPtr basic(OCSP_response_get1_basic(parsed.get()), OCSP_BASICRESP_free);
+    StorePtr store(X509_STORE_new(), X509_STORE_free);
+    if (!basic || !store)
+        return false;
+
+    /*
+     * Issuers are the trust anchors - response has to be signed by the
+     * issuer or by a responder it delegated (OCSPSigning in extended key
+     * usage). Intermediate issuer anchors the chain without its root.
+     */
+    bool partial = false;
+    for (int i = 0; i < sk_X509_num(issuers.get()); ++i) {
+        X509 *issuer = sk_X509_value(issuers.get(), i);
+        // Issuer shared by many certificates of the batch is added once
+        if (!X509_STORE_add_cert(store.get(), issuer))
+            ERR_clear_error();
+        if (X509_check_issued(issuer, issuer) != X509_V_OK)
+            partial = true;
+    }
+    if (partial)
+        X509_STORE_set_flags(store.get(), X509_V_FLAG_PARTIAL_CHAIN);
+
+    if (OCSP_basic_verify(basic.get(), issuers.get(), store.get(), 0) <= 0) {
+        LogError("OCSP response from " << url << " verification failed");
+        return false;
+    }
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        int cert_status, reason;
+        ASN1_GENERALIZEDTIME *revtime, *thisupd, *nextupd;
+
+        if (!OCSP_resp_find_status(basic.get(), ids[i], &cert_status, &reason,
+                &revtime, &thisupd, &nextupd))
+            continue;
+
+        if (!OCSP_check_validity(thisupd, nextupd, MAX_CLOCK_SKEW_SEC, -1)) {
+            LogDebug("OCSP single response outside of validity period");
+            continue;
+        }
+
+        ocsp_single_t &single = results[batch[i].id];
+        if (cert_status == V_OCSP_CERTSTATUS_GOOD)
+            single.status = ocsp_status_t::GOOD;
+        else if (cert_status == V_OCSP_CERTSTATUS_REVOKED)
+            single.status = ocsp_status_t::REVOKED;
+        single.this_update = to_time_t(thisupd);
+        single.next_update = to_time_t(nextupd);
+    }
+
+    response.swap(response_der);
+    return true;
+}
+
+bool Ocsp::parse_response(const std::string &response, singles_t &singles)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(response.data());
+    ResponsePtr parsed(d2i_OCSP_RESPONSE(NULL, &p, response.size()),
+            OCSP_RESPONSE_free);
+    if (!parsed) {
+        LogError("Cannot parse OCSP response");
+        return false;
+    }
+
+    BasicRespPtr basic(OCSP_response_get1_basic(parsed.get()), OCSP_BASICRESP_free);
+    if (!basic)
+        return false;
+
+    for (int i = 0; i < OCSP_resp_count(basic.get()); ++i) {
+        OCSP_SINGLERESP *single = OCSP_resp_get0(basic.get(), i);
+        int reason;
+        ASN1_GENERALIZEDTIME *revtime, *thisupd, *nextupd;
+        int cert_status = OCSP_single_get0_status(single, &reason, &revtime,
+                &thisupd, &nextupd);
+
+        ocsp_single_t status{ocsp_status_t::UNKNOWN, to_time_t(thisupd), to_time_t(nextupd)};
+        if (cert_status == V_OCSP_CERTSTATUS_GOOD)
+            status.status = ocsp_status_t::GOOD;
+        else if (cert_status == V_OCSP_CERTSTATUS_REVOKED)
+            status.status = ocsp_status_t::REVOKED;
+
+        std::string key = make_key(const_cast<OCSP_CERTID*>(OCSP_SINGLERESP_get0_id(single)));
+        if (!key.empty())
+            singles.push_back(std::make_pair(key, status));
+    }
+
+    return true;
+}
+
+} // CCHECKER
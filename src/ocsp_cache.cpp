@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        ocsp_cache.cpp
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       In-memory cache of OCSP responses
+ */
+#include <ocsp_cache.h>
+
+namespace CCHECKER {
+
+OcspCache::OcspCache(size_t max_bytes) :
+    m_max_bytes(max_bytes),
+    m_bytes(0),
+    m_hits(0),
+    m_misses(0),
+    m_evictions(0)
+{}
+
+bool OcspCache::get(const std::string &key, time_t now, ocsp_status_t &status)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        ++m_misses;
+        return false;
+    }
+
+    if (it->second.next_update <= now) {
+        erase(it);
+        ++m_misses;
+        return false;
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lru_pos);
+    status = it->second.status;
+    ++m_hits;
+    return true;
+}
+
+void OcspCache::put(const std::string &key,
+                    const ocsp_single_t &single,
+                    const response_ptr &response,
+                    size_t shares,
+                    time_t now)
+{
+    // Without nextUpdate newer information is available at any time
+    if (single.status == ocsp_status_t::UNKNOWN || single.next_update <= now)
+        return;
+
+    size_t response_bytes = response ? response->size() : 0;
+    if (shares == 0)
+        shares = 1;
+    size_t bytes = sizeof(entry_t) + 2 * key.size() +
+                   (response_bytes + shares - 1) / shares;
+    if (bytes > m_max_bytes)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_entries.find(key);
+    if (it != m_entries.end())
+        erase(it);
+
+    m_lru.push_front(key);
+    entry_t &entry = m_entries[key];
+    entry.status = single.status;
+    entry.next_update = single.next_update;
+    entry.response = response;
+    entry.bytes = bytes;
+    entry.lru_pos = m_lru.begin();
+    m_bytes += bytes;
+
+    evict();
+}
+
+OcspCache::stats_t OcspCache::stats(void) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return stats_t{m_hits, m_misses, m_evictions, m_entries.size(), m_bytes};
+}
+
+void OcspCache::erase(map_t::iterator it)
+{
+    m_bytes -= it->second.bytes;
+    m_lru.erase(it->second.lru_pos);
+    m_entries.erase(it);
+}
+
+void OcspCache::evict(void)
+{
+    while (m_bytes > m_max_bytes && !m_lru.empty()) {
+        auto it = m_entries.find(m_lru.back());
+        erase(it);
+        ++m_evictions;
+    }
+}
+
+} // CCHECKER
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        signature_file.cpp
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Change detection of package signature files
+ */
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cert_store.h>
+#include <log.h>
+#include <signature_file.h>
+
+namespace {
+
+const int64_t NS_PER_SEC = 1000000000;
+
+// Coarsest mtime resolution of filesystems in use (FAT keeps 2 s)
+const int64_t RACY_WINDOW_NS = 2 * NS_PER_SEC;
+
+int64_t to_ns(const struct timespec &time)
+{
+    return static_cast<int64_t>(time.tv_sec) * NS_PER_SEC + time.tv_nsec;
+}
+
+} //anonymus
+
+namespace CCHECKER {
+
+bool stat_signature(const std::string &path, signature_file_t &file)
+{
+    file = signature_file_t();
+    file.path = path;
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        LogError("Cannot stat " << path << ": " << strerror(errno));
+        return false;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    file.inode = static_cast<int64_t>(st.st_ino);
+    file.size = static_cast<int64_t>(st.st_size);
+    file.mtime = to_ns(st.st_mtim);
+    if (file.mtime + RACY_WINDOW_NS > to_ns(now))
+        file.mtime = 0;
+    return true;
+}
+
+bool hash_signature(signature_file_t &file)
+{
+    int fd = open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LogError("Cannot open " << file.path << ": " << strerror(errno));
+        return false;
+    }
+
+    bool ok = false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        LogError("Cannot stat " << file.path << ": " << strerror(errno));
+    } else if (st.st_size == 0) {
+        file.sha256 = CertStore::sha256("", 0);
+        ok = true;
+    } else {
+        size_t size = static_cast<size_t>(st.st_size);
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            LogError("Cannot map " << file.path << ": " << strerror(errno));
+        } else {
+            madvise(map, size, MADV_SEQUENTIAL);
+            file.sha256 = CertStore::sha256(static_cast<const char *>(map), size);
+            munmap(map, size);
+            ok = true;
+        }
+    }
+
+    close(fd);
+    return ok;
+}
+
+signature_state_t compare_signature(const signature_file_t &recorded,
+                                    const signature_file_t &current)
+{
+    // Migrated from before signature files were kept, content is compared
+    if (recorded.path.empty())
+        return signature_state_t::AMBIGUOUS;
+
+    // Signature that was never read completely
+    if (recorded.sha256.empty())
+        return signature_state_t::CHANGED;
+
+    if (recorded.size != current.size)
+        return signature_state_t::CHANGED;
+
+    if (recorded.path == current.path && recorded.inode == current.inode &&
+        recorded.mtime == current.mtime && recorded.mtime != 0)
+        return signature_state_t::UNCHANGED;
+
+    // E.g. touched or rewritten with the same content
+    return signature_state_t::AMBIGUOUS;
+}
+
+} // CCHECKER
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        signature_reader.cpp
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Streaming reader of certificates from XML signature files
+ */
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <log.h>
+#include <base64.h>
+#include <signature_reader.h>
+
+namespace {
+
+const char CERT_ELEMENT[] = "X509Certificate";
+const size_t CERT_ELEMENT_LEN = sizeof(CERT_ELEMENT) - 1;
+
+bool is_name_end(char c)
+{
+    return c == '>' || c == '/' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Local part of element name, without namespace prefix
+bool is_cert_element(const char *name, const char *name_end)
+{
+    const char *colon = static_cast<const char *>(memchr(name, ':', name_end - name));
+    if (colon)
+        name = colon + 1;
+    return static_cast<size_t>(name_end - name) == CERT_ELEMENT_LEN &&
+           memcmp(name, CERT_ELEMENT, CERT_ELEMENT_LEN) == 0;
+}
+
+} //anonymus
+
+namespace CCHECKER {
+
+SignatureReader::SignatureReader(const std::string &path) :
+    m_path(path),
+    m_map(MAP_FAILED),
+    m_size(0),
+    m_pos(NULL),
+    m_end(NULL),
+    m_failed(false)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LogError("Cannot open " << path << ": " << strerror(errno));
+        m_failed = true;
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        LogError("Cannot stat " << path << ": " << strerror(errno));
+        m_failed = true;
+    } else if (st.st_size > 0) {
+        m_size = static_cast<size_t>(st.st_size);
+        m_map = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m_map == MAP_FAILED) {
+            LogError("Cannot map " << path << ": " << strerror(errno));
+            m_failed = true;
+        } else {
+            // Pages already read are not needed again
+            madvise(m_map, m_size, MADV_SEQUENTIAL);
+            m_pos = static_cast<const char *>(m_map);
+            m_end = m_pos + m_size;
+        }
+    }
+
+    close(fd);
+}
+
+SignatureReader::~SignatureReader(void)
+{
+    if (m_map != MAP_FAILED)
+        munmap(m_map, m_size);
+}
+
+bool SignatureReader::failed(void) const
+{
+    return m_failed;
+}
+
+bool SignatureReader::fail(const char *reason)
+{
+    LogError("Malformed signature " << m_path << ": " << reason);
+    m_failed = true;
+    m_pos = m_end;
+    return false;
+}
+
+bool SignatureReader::skip_past(const char *end)
+{
+    size_t len = strlen(end);
+    const char *found = static_cast<const char *>(memmem(m_pos, m_end - m_pos, end, len));
+    if (!found)
+        return false;
+    m_pos = found + len;
+    return true;
+}
+
+bool SignatureReader::next(std::string &der)
+{
+    der.clear();
+
+    while (m_pos < m_end) {
+        const char *tag = static_cast<const char *>(memchr(m_pos, '<', m_end - m_pos));
+        if (!tag) {
+            m_pos = m_end;
+            return false;
+        }
+        m_pos = tag + 1;
+
+        size_t left = m_end - m_pos;
+        if (left >= 3 && memcmp(m_pos, "!--", 3) == 0) {
+            if (!skip_past("-->"))
+                return fail("unterminated comment");
+            continue;
+        }
+        if (left >= 8 && memcmp(m_pos, "![CDATA[", 8) == 0) {
+            if (!skip_past("]]>"))
+                return fail("unterminated CDATA");
+            continue;
+        }
+        if (left >= 1 && m_pos[0] == '?') {
+            if (!skip_past("?>"))
+                return fail("unterminated processing instruction");
+            continue;
+        }
+        if (left >= 1 && (m_pos[0] == '!' || m_pos[0] == '/')) {
+            if (!skip_past(">"))
+                return fail("unterminated tag");
+            continue;
+        }
+
+        // Start tag - name, attributes (quoted values may contain '>')
+        const char *name = m_pos;
+        while (m_pos < m_end && !is_name_end(*m_pos))
+            ++m_pos;
+        const char *name_end = m_pos;
+
+        char quote = 0;
+        for (; m_pos < m_end; ++m_pos) {
+            if (quote) {
+                if (*m_pos == quote)
+                    quote = 0;
+            } else if (*m_pos == '"' || *m_pos == '\'') {
+                quote = *m_pos;
+            } else if (*m_pos == '>') {
+                break;
+            }
+        }
+        if (m_pos == m_end)
+            return fail("unterminated tag");
+        bool empty = m_pos[-1] == '/';
+        ++m_pos;
+
+        if (empty || !is_cert_element(name, name_end))
+            continue;
+
+        // Certificate is text only, it ends where the next tag starts
+        const char *text = m_pos;
+        const char *text_end = static_cast<const char *>(memchr(text, '<', m_end - text));
+        if (!text_end || text_end + 1 == m_end || text_end[1] != '/')
+            return fail("X509Certificate is not text");
+        // Base64 with line breaks takes less than twice the size of DER
+        if (static_cast<size_t>(text_end - text) > 2 * MAX_CERT_SIZE)
+            return fail("certificate too large");
+
+        m_pos = text_end;
+        if (!skip_past(">"))
+            return fail("unterminated tag");
+
+        if (!base64_decode(text, text_end - text, der))
+            return fail("invalid base64");
+        if (der.size() > MAX_CERT_SIZE)
+            return fail("certificate too large");
+        if (!der.empty())
+            return true;
+    }
+    return false;
+}
+
+} // CCHECKER
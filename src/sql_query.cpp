@@ -0,0 +1,828 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        sql_query.cpp
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       This file is the implementation of SQL queries
+ */
+#include <algorithm>
+#include <set>
+
+#include <log.h>
+#include <ocsp.h>
+#include <sql_query.h>
+
+namespace {
+
+/*
+ * Schema migrations - DB_MIGRATIONS[i] moves database from version i to
+ * i + 1. Version is kept in PRAGMA user_version. Never change a migration
+ * that has been released, append a new one instead.
+ */
+const char *DB_MIGRATIONS[] = {
+    // 1: check buffer and OCSP responses
+    "CREATE TABLE IF NOT EXISTS ocsp_responses ("
+    "    id          INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "    response    BLOB NOT NULL,"
+    "    next_update INTEGER NOT NULL"
+    ");"
+    "CREATE TABLE IF NOT EXISTS to_check ("
+    "    check_id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "    pkg_id   TEXT NOT NULL,"
+    "    app_id   TEXT NOT NULL,"
+    "    uid      INTEGER NOT NULL,"
+    "    verified INTEGER NOT NULL"
+    ");"
+    "CREATE TABLE IF NOT EXISTS certs_to_check ("
+    "    check_id    INTEGER NOT NULL"
+    "                REFERENCES to_check(check_id) ON DELETE CASCADE,"
+    "    position    INTEGER NOT NULL,"
+    "    certificate BLOB NOT NULL,"
+    "    PRIMARY KEY (check_id, position)"
+    ");",
+
+    // 2: issuers with their responders, indexes for pending apps,
+    //    certificates by issuer and responses by expiry
+    "ALTER TABLE certs_to_check ADD COLUMN issuer TEXT;"
+    "CREATE TABLE ocsp_urls ("
+    "    issuer TEXT PRIMARY KEY,"
+    "    url    TEXT NOT NULL"
+    ");"
+    "CREATE INDEX to_check_pending"
+    "    ON to_check (verified, check_id, pkg_id, app_id, uid);"
+    "CREATE INDEX certs_to_check_issuer"
+    "    ON certs_to_check (issuer, check_id);"
+    "CREATE INDEX ocsp_responses_next_update"
+    "    ON ocsp_responses (next_update);",
+
+    // 3: certificates shared by apps are stored once, moved from
+    //    certs_to_check_v2 by move_certificates()
+    "CREATE TABLE certificates ("
+    "    cert_id     INTEGER PRIMARY KEY,"
+    "    sha256      BLOB NOT NULL UNIQUE,"
+    "    certificate BLOB NOT NULL,"
+    "    issuer      TEXT NOT NULL"
+    ");"
+    "CREATE INDEX certificates_issuer ON certificates (issuer);"
+    "DROP INDEX certs_to_check_issuer;"
+    "ALTER TABLE certs_to_check RENAME TO certs_to_check_v2;"
+    "CREATE TABLE certs_to_check ("
+    "    check_id INTEGER NOT NULL"
+    "             REFERENCES to_check(check_id) ON DELETE CASCADE,"
+    "    position INTEGER NOT NULL,"
+    "    cert_id  INTEGER NOT NULL REFERENCES certificates(cert_id),"
+    "    PRIMARY KEY (check_id, position)"
+    ");"
+    "CREATE INDEX certs_to_check_cert ON certs_to_check (cert_id, check_id);",
+
+    // 4: packages seen already, to find ones installed while cert-checker
+    //    wasn't running
+    "CREATE TABLE packages ("
+    "    pkg_id TEXT PRIMARY KEY"
+    ");"
+    "INSERT OR IGNORE INTO packages (pkg_id) SELECT pkg_id FROM to_check;",
+
+    // 5: signature file of each package, to skip unchanged ones
+    "ALTER TABLE packages ADD COLUMN path TEXT NOT NULL DEFAULT '';"
+    "ALTER TABLE packages ADD COLUMN inode INTEGER NOT NULL DEFAULT 0;"
+    "ALTER TABLE packages ADD COLUMN size INTEGER NOT NULL DEFAULT 0;"
+    "ALTER TABLE packages ADD COLUMN mtime INTEGER NOT NULL DEFAULT 0;"
+    "ALTER TABLE packages ADD COLUMN sha256 BLOB NOT NULL DEFAULT x'';"
+};
+
+const int DB_VERSION = sizeof(DB_MIGRATIONS) / sizeof(DB_MIGRATIONS[0]);
+
+const char *DB_CMD_GET_VERSION =
+        "PRAGMA user_version;";
+
+const char *DB_CMD_SET_VERSION =
+        "PRAGMA user_version = %d;";
+
+const char *DB_CMD_SELECT_CERTS_TO_MOVE =
+        "SELECT check_id, position, certificate FROM certs_to_check_v2;";
+
+const char *DB_CMD_DROP_MOVED_CERTS =
+        "DROP TABLE certs_to_check_v2;";
+
+const char *DB_CMD_INSERT_OCSP_RESPONSE =
+        "INSERT INTO ocsp_responses (response, next_update) VALUES (?, ?);";
+
+const char *DB_CMD_DELETE_EXPIRED_OCSP_RESPONSES =
+        "DELETE FROM ocsp_responses WHERE next_update <= ?;";
+
+const char *DB_CMD_SELECT_OCSP_RESPONSES =
+        "SELECT response FROM ocsp_responses;";
+
+const char *DB_CMD_INSERT_TO_CHECK =
+        "INSERT INTO to_check (pkg_id, app_id, uid, verified) VALUES (?, ?, ?, ?);";
+
+const char *DB_CMD_INSERT_CERT_TO_CHECK =
+        "INSERT INTO certs_to_check (check_id, position, cert_id) VALUES (?, ?, ?);";
+
+const char *DB_CMD_SELECT_CERT_ID =
+        "SELECT cert_id FROM certificates WHERE sha256 = ?;";
+
+const char *DB_CMD_INSERT_CERT =
+        "INSERT INTO certificates (sha256, certificate, issuer) VALUES (?, ?, ?);";
+
+const char *DB_CMD_DELETE_CERT_IF_UNUSED =
+        "DELETE FROM certificates WHERE sha256 = ? AND NOT EXISTS"
+        "    (SELECT 1 FROM certs_to_check WHERE cert_id = certificates.cert_id);";
+
+const char *DB_CMD_DELETE_UNUSED_CERTS =
+        "DELETE FROM certificates WHERE NOT EXISTS"
+        "    (SELECT 1 FROM certs_to_check WHERE cert_id = certificates.cert_id);";
+
+const char *DB_CMD_INSERT_PACKAGE =
+        "INSERT OR REPLACE INTO packages (pkg_id, path, inode, size, mtime, sha256) "
+        "VALUES (?, ?, ?, ?, ?, ?);";
+
+const char *DB_CMD_SELECT_PACKAGES =
+        "SELECT pkg_id, path, inode, size, mtime, sha256 FROM packages;";
+
+const char *DB_CMD_SELECT_PACKAGE_SHA256 =
+        "SELECT sha256 FROM packages WHERE pkg_id = ?;";
+
+const char *DB_CMD_DELETE_PACKAGE =
+        "DELETE FROM packages WHERE pkg_id = ?;";
+
+const char *DB_CMD_DELETE_TO_CHECK =
+        "DELETE FROM to_check WHERE check_id = ?;";
+
+const char *DB_CMD_SELECT_TO_CHECK_PAGE =
+        "SELECT check_id, pkg_id, app_id, uid, verified FROM to_check"
+        "    WHERE verified = ? AND check_id > ? ORDER BY check_id LIMIT ?;";
+
+const char *DB_CMD_SELECT_LAST_CHECK_ID =
+        "SELECT IFNULL(MAX(check_id), 0) FROM to_check;";
+
+const char *DB_CMD_SELECT_CERTS_TO_CHECK_RANGE =
+        "SELECT t.check_id, c.sha256, c.certificate"
+        "    FROM certs_to_check t JOIN certificates c ON c.cert_id = t.cert_id"
+        "    WHERE t.check_id BETWEEN ? AND ? ORDER BY t.check_id, t.position;";
+
+const char *DB_CMD_SELECT_CHECK_IDS_BY_ISSUER =
+        "SELECT DISTINCT t.check_id"
+        "    FROM certificates c JOIN certs_to_check t ON t.cert_id = c.cert_id"
+        "    WHERE c.issuer = ? ORDER BY t.check_id;";
+
+const char *DB_CMD_INSERT_OCSP_URL =
+        "INSERT OR REPLACE INTO ocsp_urls (issuer, url) VALUES (?, ?);";
+
+const char *DB_CMD_SELECT_OCSP_URLS =
+        "SELECT issuer, url FROM ocsp_urls;";
+
+// Blob bound without copy - value has to outlive the statement step
+CCHECKER::DB::SqlConnection::BlobView blob_view(const std::string &value)
+{
+    CCHECKER::DB::SqlConnection::BlobView view = {
+        reinterpret_cast<const unsigned char *>(value.data()), value.size()
+    };
+    return view;
+}
+
+// Many small writes on flash storage: WAL and sync on checkpoint only
+CCHECKER::DB::SqlConnection::Flag::Pragmas db_pragmas(void)
+{
+    CCHECKER::DB::SqlConnection::Flag::Pragmas pragmas;
+    pragmas.journal = CCHECKER::DB::SqlConnection::Flag::JournalWal;
+    pragmas.synchronous = CCHECKER::DB::SqlConnection::Flag::SynchronousNormal;
+    pragmas.cacheSize = -512;              // 512 KiB
+    pragmas.mmapSize = 4 * 1024 * 1024;
+    pragmas.walAutoCheckpoint = 256;       // pages
+    pragmas.journalSizeLimit = 1024 * 1024;
+    return pragmas;
+}
+
+} //anonymus
+
+namespace CCHECKER {
+namespace DB {
+
+SqlQuery::SqlQuery(void) :
+    m_group_window(0),
+    m_group_exit(false)
+{}
+
+SqlQuery::~SqlQuery(void)
+{
+    stop_group_commit();
+}
+
+void SqlQuery::set_group_commit(std::chrono::milliseconds window)
+{
+    stop_group_commit();
+
+    if (window.count() <= 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_group_window = window;
+    m_group_exit = false;
+    m_group_thread = std::thread(&SqlQuery::run_group_commit, this);
+}
+
+void SqlQuery::stop_group_commit(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_group_exit = true;
+        m_group_window = std::chrono::milliseconds(0);
+    }
+    m_group_cond.notify_one();
+
+    if (m_group_thread.joinable())
+        m_group_thread.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    commit_group();
+}
+
+bool SqlQuery::flush(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return commit_group();
+}
+
+void SqlQuery::begin_group(SqlConnection &writer)
+{
+    if (m_group || m_group_window.count() == 0)
+        return;
+
+    m_group.reset(new SqlConnection::ScopedTransaction(&writer,
+            SqlConnection::ScopedTransaction::Immediate));
+    m_group_deadline = std::chrono::steady_clock::now() + m_group_window;
+    m_group_cond.notify_one();
+}
+
+bool SqlQuery::commit_group(void)
+{
+    if (!m_group)
+        return true;
+
+    // Readers may fall back to the writer, it has to be leased
+    SqlConnectionPool::Lease writer = m_pool->GetWriter();
+    transaction_ptr group(std::move(m_group));
+    try {
+        group->Commit();
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot commit grouped writes: " << e.GetMessage());
+        return false;
+    }
+    return true;
+}
+
+void SqlQuery::run_group_commit(void)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_group_exit) {
+        if (!m_group) {
+            m_group_cond.wait(lock);
+        } else if (std::chrono::steady_clock::now() < m_group_deadline) {
+            m_group_cond.wait_until(lock, m_group_deadline);
+        } else {
+            commit_group();
+        }
+    }
+}
+
+bool SqlQuery::connect(const std::string &path, size_t readers)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    commit_group();
+
+    try {
+        m_pool.reset(new SqlConnectionPool(path, readers, db_pragmas()));
+        SqlConnectionPool::Lease writer = m_pool->GetWriter();
+        if (!migrate(*writer)) {
+            m_pool.reset();
+            return false;
+        }
+        // Left by apps removed without their certificates known
+        writer->Execute(DB_CMD_DELETE_UNUSED_CERTS);
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot open database " << path << ": " << e.GetMessage());
+        m_pool.reset();
+        return false;
+    }
+
+    LogDebug("Connected to database " << path);
+    return true;
+}
+
+bool SqlQuery::migrate(SqlConnection &writer)
+{
+    int version = 0;
+    {
+        SqlConnection::DataCommandUniquePtr select = writer.Query(DB_CMD_GET_VERSION);
+        if (!select->StepRow(version))
+            version = 0;
+    }
+
+    if (version > DB_VERSION) {
+        LogError("Database version " << version << " is newer than supported " <<
+                DB_VERSION);
+        return false;
+    }
+    if (version == DB_VERSION)
+        return true;
+
+    // All steps or none - failed upgrade is retried on the next start
+    SqlConnection::ScopedTransaction transaction(&writer,
+            SqlConnection::ScopedTransaction::Exclusive);
+    for (int i = version; i < DB_VERSION; ++i) {
+        LogInfo("Migrating database from version " << i << " to " << i + 1);
+        writer.ExecCommand(DB_MIGRATIONS[i]);
+    }
+    if (version < 3)
+        move_certificates(writer);
+    writer.ExecCommand(DB_CMD_SET_VERSION, DB_VERSION);
+    transaction.Commit();
+    return true;
+}
+
+// Before version 3 every app had own copies of its certificates
+void SqlQuery::move_certificates(SqlConnection &writer)
+{
+    SqlConnection::DataCommandUniquePtr select =
+        writer.PrepareDataCommand(DB_CMD_SELECT_CERTS_TO_MOVE);
+    SqlConnection::DataCommandUniquePtr insert =
+        writer.PrepareDataCommand(DB_CMD_INSERT_CERT_TO_CHECK);
+
+    int32_t check_id;
+    int position;
+    std::string der;
+    while (select->StepRow(check_id, position, der)) {
+        cert_ptr cert = CertStore::instance().intern(der);
+        insert->BindAll(check_id, position, insert_certificate(writer, *cert));
+        insert->Step();
+        insert->Reset();
+    }
+    select.reset();
+
+    writer.ExecCommand(DB_CMD_DROP_MOVED_CERTS);
+}
+
+bool SqlQuery::add_ocsp_response(const std::string &response, time_t next_update)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_pool)
+        return false;
+
+    try {
+        SqlConnectionPool::Lease writer = m_pool->GetWriter();
+        begin_group(*writer);
+        SqlConnection::ScopedTransaction transaction(writer.Get(),
+                SqlConnection::ScopedTransaction::Immediate);
+
+        writer->Execute(DB_CMD_INSERT_OCSP_RESPONSE,
+                blob_view(response), static_cast<int64_t>(next_update));
+
+        transaction.Commit();
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot store OCSP response: " << e.GetMessage());
+        return false;
+    }
+    return true;
+}
+
+bool SqlQuery::get_ocsp_responses(time_t now, std::vector<std::string> &responses)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_pool)
+            return false;
+
+        try {
+            SqlConnectionPool::Lease writer = m_pool->GetWriter();
+            writer->Execute(DB_CMD_DELETE_EXPIRED_OCSP_RESPONSES,
+                    static_cast<int64_t>(now));
+        } catch (const SqlConnection::Exception::Base &e) {
+            LogError("Cannot remove expired OCSP responses: " << e.GetMessage());
+            return false;
+        }
+    }
+
+    try {
+        SqlConnectionPool::Lease reader = m_pool->GetReader();
+        SqlConnection::DataCommandUniquePtr select =
+            reader->Query(DB_CMD_SELECT_OCSP_RESPONSES);
+        SqlConnection::BlobView response;
+        while (select->StepRow(response))
+            responses.emplace_back(reinterpret_cast<const char *>(response.data),
+                                   response.size);
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot load OCSP responses: " << e.GetMessage());
+        return false;
+    }
+    return true;
+}
+
+int64_t SqlQuery::insert_certificate(SqlConnection &writer, const certificate_t &cert)
+{
+    {
+        SqlConnection::DataCommandUniquePtr select =
+            writer.Query(DB_CMD_SELECT_CERT_ID, blob_view(cert.sha256));
+        int64_t cert_id;
+        if (select->StepRow(cert_id))
+            return cert_id;
+    }
+
+    // Issuer is empty if certificate can't be parsed, it won't match any
+    writer.Execute(DB_CMD_INSERT_CERT, blob_view(cert.sha256), blob_view(cert.der),
+            Ocsp::issuer_name(cert.der));
+    return writer.GetLastInsertRowID();
+}
+
+void SqlQuery::insert_app(SqlConnection &writer,
+                          SqlConnection::DataCommand &insert,
+                          SqlConnection::DataCommand &insert_cert,
+                          app_t &app)
+{
+    insert.BindAll(app.pkg_id, app.app_id, app.uid, static_cast<int>(app.verified));
+    insert.Step();
+    insert.Reset();
+    int32_t check_id = static_cast<int32_t>(writer.GetLastInsertRowID());
+    // Package is recorded only with a signature read as a whole
+    if (!app.signature.sha256.empty())
+        insert_package(writer, app.pkg_id, app.signature);
+
+    for (size_t i = 0; i < app.certificates.size(); ++i) {
+        insert_cert.BindAll(check_id, static_cast<int>(i),
+                            insert_certificate(writer, *app.certificates[i]));
+        insert_cert.Step();
+        insert_cert.Reset();
+    }
+
+    app.check_id = check_id;
+}
+
+bool SqlQuery::add_app_to_check(app_t &app)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_pool)
+        return false;
+
+    try {
+        SqlConnectionPool::Lease writer = m_pool->GetWriter();
+        begin_group(*writer);
+        SqlConnection::ScopedTransaction transaction(writer.Get(),
+                SqlConnection::ScopedTransaction::Immediate);
+
+        SqlConnection::DataCommandUniquePtr insert =
+            writer->PrepareCachedDataCommand(DB_CMD_INSERT_TO_CHECK);
+        SqlConnection::DataCommandUniquePtr insert_cert =
+            writer->PrepareCachedDataCommand(DB_CMD_INSERT_CERT_TO_CHECK);
+        insert_app(*writer, *insert, *insert_cert, app);
+
+        transaction.Commit();
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot add app to check: " << e.GetMessage());
+        return false;
+    }
+    return true;
+}
+
+size_t SqlQuery::add_apps_to_check(std::vector<app_t> &apps)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return insert_apps(apps);
+}
+
+size_t SqlQuery::add_new_apps_to_check(std::vector<app_t> &apps)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_pool || apps.empty())
+        return 0;
+
+    try {
+        // Rows of the open group are seen by the writer only
+        SqlConnectionPool::Lease writer = m_pool->GetWriter();
+        std::set<std::string> checked;
+        std::set<std::string> stored;
+        for (const auto &app : apps) {
+            if (app.signature.sha256.empty() || !checked.insert(app.pkg_id).second)
+                continue;
+
+            SqlConnection::DataCommandUniquePtr select =
+                writer->Query(DB_CMD_SELECT_PACKAGE_SHA256, app.pkg_id);
+            SqlConnection::BlobView sha256;
+            if (select->StepRow(sha256) &&
+                app.signature.sha256.compare(0, std::string::npos,
+                        reinterpret_cast<const char *>(sha256.data), sha256.size) == 0)
+                stored.insert(app.pkg_id);
+        }
+
+        apps.erase(std::remove_if(apps.begin(), apps.end(),
+                [&stored](const app_t &app) { return stored.count(app.pkg_id) != 0; }),
+                apps.end());
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot get stored packages: " << e.GetMessage());
+        return 0;
+    }
+
+    return insert_apps(apps);
+}
+
+size_t SqlQuery::insert_apps(std::vector<app_t> &apps)
+{
+    if (!m_pool || apps.empty())
+        return 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t added = 0;
+    size_t certs = 0;
+    try {
+        SqlConnectionPool::Lease writer = m_pool->GetWriter();
+        begin_group(*writer);
+        SqlConnection::ScopedTransaction transaction(writer.Get(),
+                SqlConnection::ScopedTransaction::Immediate);
+
+        SqlConnection::DataCommandUniquePtr insert =
+            writer->PrepareCachedDataCommand(DB_CMD_INSERT_TO_CHECK);
+        SqlConnection::DataCommandUniquePtr insert_cert =
+            writer->PrepareCachedDataCommand(DB_CMD_INSERT_CERT_TO_CHECK);
+
+        for (auto &app : apps) {
+            // App that can't be stored doesn't take the others with it
+            SqlConnection::ScopedTransaction savepoint(writer.Get());
+            try {
+                insert_app(*writer, *insert, *insert_cert, app);
+                savepoint.Commit();
+                ++added;
+                certs += app.certificates.size();
+            } catch (const SqlConnection::Exception::Base &e) {
+                LogError("Cannot add app " << app.pkg_id << " to check: " << e.GetMessage());
+                insert->Reset();
+                insert_cert->Reset();
+            }
+        }
+
+        transaction.Commit();
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot add apps to check: " << e.GetMessage());
+        return 0;
+    }
+
+    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    LogDebug("Added " << added << " apps with " << certs << " certificates in " <<
+            us << " us (" << (added + certs) * 1000000 / (us > 0 ? us : 1) << " rows/s)");
+    return added;
+}
+
+bool SqlQuery::remove_app_from_check(const app_t &app)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_pool)
+        return false;
+
+    try {
+        SqlConnectionPool::Lease writer = m_pool->GetWriter();
+        begin_group(*writer);
+        SqlConnection::ScopedTransaction transaction(writer.Get(),
+                SqlConnection::ScopedTransaction::Immediate);
+
+        // References to certificates are removed by ON DELETE CASCADE,
+        // certificates themselves when no other app uses them
+        writer->Execute(DB_CMD_DELETE_TO_CHECK, app.check_id);
+        for (const auto &cert : app.certificates)
+            writer->Execute(DB_CMD_DELETE_CERT_IF_UNUSED, blob_view(cert->sha256));
+
+        transaction.Commit();
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot remove app from check: " << e.GetMessage());
+        return false;
+    }
+    return true;
+}
+
+bool SqlQuery::get_apps_to_check(int32_t after_check_id,
+                                 size_t limit,
+                                 std::vector<app_t> &apps)
+{
+    if (!m_pool)
+        return false;
+
+    size_t first = apps.size();
+    try {
+        // Both queries in one read transaction, so they see the same data
+        SqlConnectionPool::Lease reader = m_pool->GetReader();
+        SqlConnection::ScopedTransaction transaction(reader.Get());
+
+        SqlConnection::DataCommandUniquePtr select =
+            reader->Query(DB_CMD_SELECT_TO_CHECK_PAGE,
+                    static_cast<int>(app_t::verified_t::UNKNOWN),
+                    after_check_id, static_cast<int64_t>(limit));
+
+        app_t app;
+        int verified;
+        while (select->StepRow(app.check_id, app.pkg_id, app.app_id, app.uid, verified)) {
+            app.verified = static_cast<app_t::verified_t>(verified);
+            apps.push_back(app);
+        }
+
+        if (apps.size() == first)
+            return true;
+
+        // Certificates of the whole page at once, in the same order as apps
+        SqlConnection::DataCommandUniquePtr certs =
+            reader->Query(DB_CMD_SELECT_CERTS_TO_CHECK_RANGE,
+                    apps[first].check_id, apps.back().check_id);
+        size_t i = first;
+        int32_t check_id;
+        SqlConnection::BlobView sha256, cert;
+        while (certs->StepRow(check_id, sha256, cert)) {
+            while (i < apps.size() && apps[i].check_id < check_id)
+                ++i;
+            if (i == apps.size())
+                break;
+            if (apps[i].check_id == check_id)
+                apps[i].certificates.push_back(CertStore::instance().intern(
+                        std::string(reinterpret_cast<const char *>(sha256.data),
+                                    sha256.size),
+                        reinterpret_cast<const char *>(cert.data), cert.size));
+        }
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot get apps to check: " << e.GetMessage());
+        apps.resize(first);
+        return false;
+    }
+    return true;
+}
+
+bool SqlQuery::get_last_check_id(int32_t &check_id)
+{
+    if (!m_pool)
+        return false;
+
+    try {
+        SqlConnectionPool::Lease reader = m_pool->GetReader();
+        SqlConnection::DataCommandUniquePtr select =
+            reader->Query(DB_CMD_SELECT_LAST_CHECK_ID);
+        if (!select->StepRow(check_id))
+            check_id = 0;
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot get last check id: " << e.GetMessage());
+        return false;
+    }
+    return true;
+}
+
+bool SqlQuery::get_check_ids_by_issuer(const std::string &issuer,
+                                       std::vector<int32_t> &check_ids)
+{
+    if (!m_pool)
+        return false;
+
+    try {
+        SqlConnectionPool::Lease reader = m_pool->GetReader();
+        SqlConnection::DataCommandUniquePtr select =
+            reader->Query(DB_CMD_SELECT_CHECK_IDS_BY_ISSUER, issuer);
+        int32_t check_id;
+        while (select->StepRow(check_id))
+            check_ids.push_back(check_id);
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot get apps by issuer: " << e.GetMessage());
+        return false;
+    }
+    return true;
+}
+
+bool SqlQuery::set_ocsp_url(const std::string &issuer, const std::string &url)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_pool)
+        return false;
+
+    try {
+        SqlConnectionPool::Lease writer = m_pool->GetWriter();
+        begin_group(*writer);
+        SqlConnection::ScopedTransaction transaction(writer.Get(),
+                SqlConnection::ScopedTransaction::Immediate);
+
+        writer->Execute(DB_CMD_INSERT_OCSP_URL, issuer, url);
+
+        transaction.Commit();
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot store OCSP url: " << e.GetMessage());
+        return false;
+    }
+    return true;
+}
+
+bool SqlQuery::get_ocsp_urls(std::map<std::string, std::string> &urls)
+{
+    if (!m_pool)
+        return false;
+
+    try {
+        SqlConnectionPool::Lease reader = m_pool->GetReader();
+        SqlConnection::DataCommandUniquePtr select =
+            reader->Query(DB_CMD_SELECT_OCSP_URLS);
+        std::string issuer, url;
+        while (select->StepRow(issuer, url))
+            urls[issuer] = url;
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot load OCSP urls: " << e.GetMessage());
+        return false;
+    }
+    return true;
+}
+
+void SqlQuery::insert_package(SqlConnection &writer,
+                              const std::string &pkg_id,
+                              const signature_file_t &signature)
+{
+    writer.Execute(DB_CMD_INSERT_PACKAGE, pkg_id, signature.path,
+            signature.inode, signature.size, signature.mtime,
+            blob_view(signature.sha256));
+}
+
+bool SqlQuery::get_packages(std::map<std::string, signature_file_t> &packages)
+{
+    if (!m_pool)
+        return false;
+
+    try {
+        SqlConnectionPool::Lease reader = m_pool->GetReader();
+        SqlConnection::DataCommandUniquePtr select =
+            reader->Query(DB_CMD_SELECT_PACKAGES);
+        std::string pkg_id;
+        signature_file_t signature;
+        SqlConnection::BlobView sha256;
+        while (select->StepRow(pkg_id, signature.path, signature.inode,
+                               signature.size, signature.mtime, sha256)) {
+            signature.sha256.assign(reinterpret_cast<const char *>(sha256.data),
+                                    sha256.size);
+            packages[pkg_id] = signature;
+        }
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot get packages: " << e.GetMessage());
+        return false;
+    }
+    return true;
+}
+
+bool SqlQuery::set_package(const std::string &pkg_id, const signature_file_t &signature)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_pool)
+        return false;
+
+    try {
+        SqlConnectionPool::Lease writer = m_pool->GetWriter();
+        begin_group(*writer);
+        SqlConnection::ScopedTransaction transaction(writer.Get(),
+                SqlConnection::ScopedTransaction::Immediate);
+
+        insert_package(*writer, pkg_id, signature);
+
+        transaction.Commit();
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot store package " << pkg_id << ": " << e.GetMessage());
+        return false;
+    }
+    return true;
+}
+
+bool SqlQuery::remove_packages(const std::vector<std::string> &pkg_ids)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_pool)
+        return false;
+
+    try {
+        SqlConnectionPool::Lease writer = m_pool->GetWriter();
+        begin_group(*writer);
+        SqlConnection::ScopedTransaction transaction(writer.Get(),
+                SqlConnection::ScopedTransaction::Immediate);
+
+        for (const auto &pkg_id : pkg_ids)
+            writer->Execute(DB_CMD_DELETE_PACKAGE, pkg_id);
+
+        transaction.Commit();
+    } catch (const SqlConnection::Exception::Base &e) {
+        LogError("Cannot remove packages: " << e.GetMessage());
+        return false;
+    }
+    return true;
+}
+
+} // DB
+} // CCHECKER
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2015 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+/*
+ * @file        thread_pool.cpp
+ * @author      Janusz Kozerski (j.kozerski@samsung.com)
+ * @version     1.0
+ * @brief       Fixed size pool of worker threads
+ */
+#include <exception>
+#include <system_error>
+
+#include <log.h>
+#include <thread_pool.h>
+
+namespace CCHECKER {
+
+ThreadPool::ThreadPool(unsigned int threads) :
+    m_stop(false)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    // hardware_concurrency() may return 0 if it's not computable
+    if (threads == 0)
+        threads = 1;
+
+    try {
+        for (unsigned int i = 0; i < threads; ++i)
+            m_threads.push_back(std::thread(&ThreadPool::run, this));
+    } catch (const std::system_error &) {
+        stop();
+        throw;
+    }
+
+    LogDebug("Thread pool started with " << m_threads.size() << " threads");
+}
+
+ThreadPool::~ThreadPool(void)
+{
+    stop();
+}
+
+void ThreadPool::stop(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+
+    for (auto &thread : m_threads)
+        if (thread.joinable())
+            thread.join();
+}
+
+void ThreadPool::submit(task_t task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push(std::move(task));
+    }
+    m_cv.notify_one();
+}
+
+size_t ThreadPool::size(void) const
+{
+    return m_threads.size();
+}
+
+size_t ThreadPool::pending(void) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_tasks.size();
+}
+
+void ThreadPool::run(void)
+{
+    for (;;) {
+        task_t task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_stop && m_tasks.empty())
+                m_cv.wait(lock);
+
+            // Tasks left in the queue are abandoned on stop
+            if (m_stop)
+                return;
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+
+        try {
+            task();
+        } catch (const std::exception &e) {
+            LogError("Unhandled exception in pool task: " << e.what());
+        } catch (...) {
+            LogError("Unhandled unknown exception in pool task");
+        }
+    }
+}
+
+} // CCHECKER